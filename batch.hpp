@@ -0,0 +1,198 @@
+#ifndef BATCH_HPP_
+#define BATCH_HPP_
+
+#include "simulator.hpp"
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// A fixed set of worker threads, each with its own deque of jobs. Workers take
+// jobs from the back of their own deque and, once it is empty, steal from the
+// front of the others', so a few long traces do not leave the other cores idle.
+class work_stealing_pool_t {
+public:
+    explicit work_stealing_pool_t(unsigned int workers):
+        queues(workers ? workers : 1) {}
+
+    //Adds a job, spreading jobs round-robin over the workers
+    void submit(std::function<void()> job) {
+        queue_t& queue = queues[next_queue++ % queues.size()];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.jobs.push_back(std::move(job));
+    }
+
+    //Runs every submitted job and returns once all of them are done
+    void run() {
+        std::vector<std::thread> threads;
+        for(size_t worker = 0; worker < queues.size(); worker++) {
+            threads.emplace_back(&work_stealing_pool_t::work, this, worker);
+        }
+        for(auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    struct queue_t {
+        std::mutex                          lock;
+        std::deque<std::function<void()>>   jobs;
+    };
+
+    bool take(size_t worker, std::function<void()>& job) {
+        {
+            queue_t& own = queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if(!own.jobs.empty()) {
+                job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                return true;
+            }
+        }
+        for(size_t i = 1; i < queues.size(); i++) {
+            queue_t& victim = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if(!victim.jobs.empty()) {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //No job is submitted while the pool runs, so a worker that finds every
+    //deque empty is done
+    void work(size_t worker) {
+        std::function<void()> job;
+        while(take(worker, job)) {
+            job();
+        }
+    }
+
+    std::vector<queue_t>    queues;
+    size_t                  next_queue = 0;
+};
+
+//Lists the traces of a batch: every .txt (or binary .bin) file of a directory
+//(sorted by name), or the paths listed one per line in a file
+std::vector<std::string> list_batch_traces(const std::string& batch) {
+    std::vector<std::string> traces;
+
+    if(std::filesystem::is_directory(batch)) {
+        for(const auto& entry : std::filesystem::directory_iterator(batch)) {
+            if(entry.is_regular_file() && (entry.path().extension() == ".txt" || entry.path().extension() == ".bin")) {
+                traces.push_back(entry.path().string());
+            }
+        }
+        std::sort(traces.begin(), traces.end());
+        return traces;
+    }
+
+    std::ifstream input_file(batch);
+    std::string trace;
+    while(std::getline(input_file, trace)) {
+        if(!trace.empty() && trace.back() == '\r') {
+            trace.pop_back();
+        }
+        if(!trace.empty()) {
+            traces.push_back(trace);
+        }
+    }
+    return traces;
+}
+
+//Simulates one trace of a batch into the directory `output`
+//returns false (after saying why) if it could not be simulated
+bool run_batch_trace(const std::string& trace, const std::filesystem::path& output, const sim_config_t& config,
+                     const sim_options_t& options, program_cache_t& program_cache, std::mutex& print_lock) {
+    compiled_trace_t trace_file;
+    bool loaded = load_trace_file(trace, trace_file);
+    std::error_code error;
+    std::filesystem::create_directories(output, error);
+    if(!loaded || error) {
+        std::lock_guard<std::mutex> guard(print_lock);
+        std::cerr << "Error: Unable to simulate " << trace << std::endl;
+        return false;
+    }
+
+    trace_view_t trace_view(&trace_file);
+
+    std::string execution_path = (output / "execution.txt").string();
+    std::string status_path = (output / "system_status.txt").string();
+    output_sink_t execution(execution_path.c_str(), options.output_buffer, options.async_output);
+    output_sink_t system_status(status_path.c_str(), options.output_buffer, options.async_output);
+
+    simulator_t simulator(config, options, program_cache);
+    if(!options.time_index_file.empty()) {
+        simulator.index = open_time_index(options, output);
+    }
+    int end_time = simulator.run(trace_view, execution, system_status);
+
+    bool opened = execution.is_open() && system_status.is_open();
+    execution.close();
+    system_status.close();
+    if(simulator.profile) {
+        write_time_profile(*simulator.profile, options, output);
+    }
+    if(simulator.index && !simulator.index->close(end_time)) {
+        std::lock_guard<std::mutex> guard(print_lock);
+        std::cerr << "Error writing the time index of " << trace << std::endl;
+    }
+
+    std::lock_guard<std::mutex> guard(print_lock);
+    if(!opened || execution.failed() || system_status.failed()) {
+        std::cerr << "Error: Unable to write the output of " << trace << " in " << output.string() << std::endl;
+        return false;
+    }
+    std::cout << trace << ": done at " << end_time << " ms, output in " << output.string() << std::endl;
+    return true;
+}
+
+//Simulates every trace of the batch on its own simulator, spread over a
+//work-stealing pool. Trace <name>.txt writes <output>/<name>/execution.txt and
+//<output>/<name>/system_status.txt, with its --time-profile, --pid-summary and
+//--time-index files next to them.
+//returns the number of traces that could not be simulated
+int run_batch(const std::string& batch, const sim_config_t& config, const sim_options_t& options, program_cache_t& program_cache) {
+    std::vector<std::string> traces = list_batch_traces(batch);
+
+    unsigned int workers = options.jobs ? options.jobs : std::thread::hardware_concurrency();
+    work_stealing_pool_t pool(workers);
+
+    std::mutex print_lock;
+    std::atomic<int> failures(0);
+    std::map<std::string, int> used_names;
+
+    for(const auto& trace : traces) {
+        //Traces with the same name (from different directories) get numbered output directories
+        std::string name = std::filesystem::path(trace).stem().string();
+        int uses = used_names[name]++;
+        if(uses > 0) {
+            name += "_" + std::to_string(uses);
+        }
+        std::filesystem::path output = std::filesystem::path(options.batch_output) / name;
+
+        pool.submit([&, trace, output]() {
+            //A trace that throws (e.g. an interrupt without a vector) fails on its own
+            try {
+                if(!run_batch_trace(trace, output, config, options, program_cache, print_lock)) {
+                    failures++;
+                }
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> guard(print_lock);
+                std::cerr << "Error: Unable to simulate " << trace << ": " << e.what() << std::endl;
+                failures++;
+            }
+        });
+    }
+
+    pool.run();
+
+    std::cout << "Batch: " << traces.size() - failures << " of " << traces.size() << " trace(s) simulated" << std::endl;
+    return failures;
+}
+
+#endif
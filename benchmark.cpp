@@ -0,0 +1,128 @@
+/**
+ *
+ * @file benchmark.cpp
+ *
+ * Runs the simulator on a trace and reports how fast it went: time spent
+ * parsing, simulating and writing, trace lines/sec, events/sec and peak RSS.
+ * Takes the same arguments and options as the simulator, plus --repeat=<n>.
+ *
+ */
+
+#include "interrupts_101299776_101187793.hpp"
+#include "simulator.hpp"
+#include <chrono>
+#include <sys/resource.h>
+
+using benchmark_clock = std::chrono::steady_clock;
+
+double seconds_since(benchmark_clock::time_point start) {
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+}
+
+//Peak resident set size of the process, in Kb
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Time spent in each phase of one run
+struct benchmark_run_t {
+    double          parse = 0;
+    double          simulate = 0;
+    double          write = 0;
+    size_t          lines = 0;
+    size_t          events = 0;     //!< trace instructions executed, including forked children and programs
+    size_t          bytes = 0;      //!< bytes of execution and system status output
+};
+
+benchmark_run_t run_once(const char* trace, const sim_config_t& config, const sim_options_t& options) {
+    benchmark_run_t run;
+    auto start = benchmark_clock::now();
+
+    compiled_trace_t trace_file;
+    if(!load_trace_file(trace, trace_file)) {
+        std::cerr << "Error: Unable to load trace: " << trace << std::endl;
+        exit(1);
+    }
+    trace_view_t trace_view(&trace_file);
+    run.parse = seconds_since(start);
+    run.lines = trace_view.size();
+
+    // A fresh cache each run, so program loading is part of the measurement
+    program_cache_t program_cache(options.programs_dir);
+    output_sink_t execution("execution.txt", options.output_buffer, options.async_output);
+    output_sink_t system_status("system_status.txt", options.output_buffer, options.async_output);
+
+    start = benchmark_clock::now();
+    simulator_t simulator(config, options, program_cache);
+    simulator.run(trace_view, execution, system_status);
+    run.simulate = seconds_since(start);
+    run.events = simulator.instructions_executed;
+    run.bytes = execution.bytes_written() + system_status.bytes_written();
+
+    //Output is streamed while simulating; this is what is left to write out
+    start = benchmark_clock::now();
+    execution.close();
+    system_status.close();
+    run.write = seconds_since(start);
+
+    return run;
+}
+
+int main(int argc, char** argv) {
+
+    //--repeat is ours, everything else goes to the simulator
+    int repeat = 1;
+    std::vector<char*> args;
+    for(int i = 0; i < argc; i++) {
+        std::string arg(argv[i]);
+        if(i >= 5 && arg.rfind("--repeat=", 0) == 0) {
+            try {
+                repeat = std::max(1, std::stoi(arg.substr(9)));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid value for option: " << arg << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        args.push_back(argv[i]);
+    }
+
+    auto [vectors, delays, external_files] = parse_args(args.size(), args.data());
+    sim_options_t options = parse_options(args.size(), args.data());
+    sim_config_t config{vectors, delays, external_files, {}};
+    if(!options.priorities_file.empty()) {
+        config.priorities = load_priorities(options.priorities_file);
+    }
+    if(!options.partitions_file.empty()) {
+        config.partition_sizes = load_partition_sizes(options.partitions_file);
+    }
+    if(!options.timing_file.empty()) {
+        config.timing = load_timing_model(options.timing_file);
+    }
+
+    benchmark_run_t best;
+    for(int i = 0; i < repeat; i++) {
+        benchmark_run_t run = run_once(argv[1], config, options);
+        if(i == 0 || run.parse + run.simulate + run.write < best.parse + best.simulate + best.write) {
+            best = run;
+        }
+    }
+
+    double total = best.parse + best.simulate + best.write;
+    std::cout << "Trace:      " << argv[1] << " (" << best.lines << " lines)" << std::endl;
+    std::cout << "Runs:       " << repeat << ", best run reported" << std::endl;
+    std::cout << "Parse:      " << best.parse * 1000 << " ms" << std::endl;
+    std::cout << "Simulate:   " << best.simulate * 1000 << " ms" << std::endl;
+    std::cout << "Write:      " << best.write * 1000 << " ms" << std::endl;
+    std::cout << "Total:      " << total * 1000 << " ms" << std::endl;
+    if(total > 0) {
+        std::cout << "Throughput: " << static_cast<long long>(best.lines / total) << " trace lines/s, "
+                  << static_cast<long long>(best.events / total) << " events/s ("
+                  << best.events << " events, " << best.bytes << " bytes of output)" << std::endl;
+    }
+    std::cout << "Peak RSS:   " << peak_rss_kb() << " Kb" << std::endl;
+
+    return 0;
+}
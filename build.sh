@@ -4,5 +4,12 @@ if [ ! -d "bin" ]; then
 else
 	rm bin/*
 fi
-g++ -g -O0 -I . -o bin/interrupts interrupts_101299776_101187793.cpp
+g++ -g -O0 -std=c++17 -pthread -I . -o bin/interrupts interrupts_101299776_101187793.cpp
+g++ -O2 -std=c++17 -I . -o bin/trace_generator trace_generator.cpp
+g++ -O2 -std=c++17 -pthread -I . -o bin/benchmark benchmark.cpp
+g++ -O2 -std=c++17 -I . -o bin/trace_converter trace_converter.cpp
+g++ -O2 -std=c++17 -pthread -I . -o bin/sim_server sim_server.cpp
+g++ -O2 -std=c++17 -I . -o bin/time_query time_query.cpp
 #g++ -std=c++17 interrupts.cpp -o bin/interrupts_sim
+#g++ -O2 -std=c++17 -pthread -DSIM_STATS -I . -o bin/interrupts_stats interrupts_101299776_101187793.cpp
+#g++ -O2 -std=c++17 -pthread -DSIM_FIXED_TIMING -I . -o bin/interrupts_fixed interrupts_101299776_101187793.cpp
@@ -0,0 +1,133 @@
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Checkpoint files (--checkpoint / --resume) hold the whole simulator state as
+// a flat sequence of numbers and length-prefixed strings, in the writer's byte
+// order, which the header records and the reader must share. Structs are
+// written one field at a time, so neither padding nor layout ends up in the
+// file. Each part of the simulator saves and loads its own state through these
+// two streams (see simulator_t::save_checkpoint).
+
+const char      CHECKPOINT_MAGIC[8] = {'S', 'I', 'M', 'C', 'K', 'P', 'T', '\0'};
+const uint32_t  CHECKPOINT_VERSION = 4;
+const uint32_t  CHECKPOINT_BYTE_ORDER = 0x01020304;
+
+class checkpoint_writer_t {
+public:
+    template<typename value_t>
+    void put(const value_t& value) {
+        static_assert(std::is_arithmetic_v<value_t> || std::is_enum_v<value_t>, "structs are written field by field");
+        data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put_string(std::string_view text) {
+        put<uint32_t>(text.size());
+        data.append(text);
+    }
+
+    //Writes the checkpoint file
+    //returns false if it cannot be written
+    bool write(const std::string& filename) const {
+        std::ofstream output_file(filename, std::ios::binary);
+        if(!output_file.is_open()) {
+            return false;
+        }
+        output_file.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        output_file.write(reinterpret_cast<const char*>(&CHECKPOINT_VERSION), sizeof(CHECKPOINT_VERSION));
+        output_file.write(reinterpret_cast<const char*>(&CHECKPOINT_BYTE_ORDER), sizeof(CHECKPOINT_BYTE_ORDER));
+        output_file.write(data.data(), data.size());
+        output_file.close();
+        return !output_file.fail();
+    }
+
+private:
+    std::string data;
+};
+
+// Reads back what checkpoint_writer_t wrote. Reading past the end (a truncated
+// or foreign file) returns zeros and clears ok(), so loaders read everything
+// and check once at the end.
+class checkpoint_reader_t {
+public:
+    //Reads a checkpoint file
+    //returns false if it cannot be opened or is not a checkpoint of this version
+    //and byte order
+    bool open(const std::string& filename) {
+        std::ifstream input_file(filename, std::ios::binary);
+        if(!input_file.is_open()) {
+            return false;
+        }
+        data.assign((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
+        position = 0;
+        valid = true;
+
+        char magic[sizeof(CHECKPOINT_MAGIC)];
+        get_bytes(magic, sizeof(magic));
+        return valid && std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) == 0 && get<uint32_t>() == CHECKPOINT_VERSION
+               && get<uint32_t>() == CHECKPOINT_BYTE_ORDER;
+    }
+
+    template<typename value_t>
+    value_t get() {
+        static_assert(std::is_arithmetic_v<value_t> || std::is_enum_v<value_t>, "structs are read field by field");
+        value_t value{};
+        get_bytes(&value, sizeof(value));
+        return value;
+    }
+
+    std::string get_string() {
+        uint32_t length = get<uint32_t>();
+        if(length > data.size() - position) {
+            valid = false;
+            return {};
+        }
+        std::string text = data.substr(position, length);
+        position += length;
+        return text;
+    }
+
+    //Reads the element count of a container, each element taking at least
+    //`element_size` bytes (so a corrupt count cannot make us allocate wildly)
+    size_t get_count(size_t element_size = 1) {
+        uint64_t count = get<uint64_t>();
+        if(count > (data.size() - position) / (element_size ? element_size : 1)) {
+            valid = false;
+            return 0;
+        }
+        return count;
+    }
+
+    //returns false if anything read so far was missing or malformed
+    bool ok() const {
+        return valid;
+    }
+
+    //Lets a loader reject a value it read
+    void fail() {
+        valid = false;
+    }
+
+private:
+    void get_bytes(void* out, size_t size) {
+        if(!valid || size > data.size() - position) {
+            valid = false;
+            return;
+        }
+        std::memcpy(out, data.data() + position, size);
+        position += size;
+    }
+
+    std::string data;
+    size_t      position = 0;
+    bool        valid = false;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef EVENT_FORMAT_HPP_
+#define EVENT_FORMAT_HPP_
+
+#include "interrupts_101299776_101187793.hpp"
+#include "output_sink.hpp"
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Writes execution.txt events straight into an output sink: numbers go through
+// std::to_chars and text is copied from constant fragments, so logging an event
+// builds no temporary strings.
+
+void append_part(output_sink_t& out, std::string_view text) {
+    out.append(text);
+}
+
+template<typename number_t, typename = std::enable_if_t<std::is_integral_v<number_t>>>
+void append_part(output_sink_t& out, number_t value) {
+    out.append_number(value);
+}
+
+//Appends "<time>, <duration>, " followed by every part (text or number)
+template<typename... parts_t>
+void log_event(output_sink_t& out, long long time, long long duration, const parts_t&... parts) {
+    if(out.discard) {
+        return;
+    }
+    out.append_number(time);
+    out.append(", ", 2);
+    out.append_number(duration);
+    out.append(", ", 2);
+    (append_part(out, parts), ...);
+}
+
+//Appends the "time: <time>; current trace: <line>" header of a system status entry
+void log_status(output_sink_t& out, long long time, std::string_view trace_line) {
+    out.append("time: ");
+    out.append_number(time);
+    out.append("; current trace: ");
+    out.append(trace_line);
+    out.append("\n");
+}
+
+// The interrupt boilerplate (kernel entry before every ISR), with the vector
+// lookup lines of every vector formatted once up front
+class event_formatter_t {
+public:
+    explicit event_formatter_t(const std::vector<std::string>& vectors) {
+        for(size_t intr_num = 0; intr_num < vectors.size(); intr_num++) {
+            char vector_address[16];
+            snprintf(vector_address, sizeof(vector_address), "0x%04X", static_cast<unsigned int>(ADDR_BASE + (intr_num * VECTOR_SIZE)));
+            find_vector.push_back("find vector " + std::to_string(intr_num) + " in memory position " + vector_address + "\n");
+            load_address.push_back("load address " + vectors[intr_num] + " into the PC\n");
+        }
+    }
+
+    //Logs switching to kernel mode, saving the context and finding the ISR of
+    //interrupt `intr_num`, each step taking the time `timing` gives it
+    //returns the time once the ISR address is loaded
+    int interrupt(output_sink_t& out, int current_time, int intr_num, const timing_model_t& timing) const {
+        SIM_STAT_TIMER(INTR_BOILERPLATE);
+        if(intr_num < 0 || static_cast<size_t>(intr_num) >= find_vector.size()) {
+            throw std::out_of_range("interrupt " + std::to_string(intr_num) + " has no entry in the vector table");
+        }
+
+        log_event(out, current_time, timing.switch_mode, prefix, "switch to kernel mode\n");
+        current_time += timing.switch_mode;
+
+        log_event(out, current_time, timing.context_save, prefix, "context saved\n");
+        current_time += timing.context_save;
+
+        log_event(out, current_time, timing.find_vector, prefix, find_vector[intr_num]);
+        current_time += timing.find_vector;
+
+        log_event(out, current_time, timing.load_isr_address, prefix, load_address[intr_num]);
+        current_time += timing.load_isr_address;
+
+        return current_time;
+    }
+
+    std::string                     prefix;         //!< written before the text of every event (the core of a --cores run)
+
+private:
+    std::vector<std::string>        find_vector;    //!< "find vector <n> in memory position <address>\n", by vector
+    std::vector<std::string>        load_address;   //!< "load address <ISR address> into the PC\n", by vector
+};
+
+#endif
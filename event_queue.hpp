@@ -0,0 +1,85 @@
+#ifndef EVENT_QUEUE_HPP_
+#define EVENT_QUEUE_HPP_
+
+#include "checkpoint.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Something that happens at a set simulation time, independently of what the
+// CPU is running: so far, a device finishing the I/O a process is blocked on
+struct sim_event_t {
+    long long   time;
+    uint64_t    sequence;   //!< events due at the same time are delivered in the order they were scheduled
+    size_t      context;    //!< the process waiting for the event
+    int         device;
+
+    bool operator>(const sim_event_t& other) const {
+        return time != other.time ? time > other.time : sequence > other.sequence;
+    }
+};
+
+// Pending events, ordered by time: a binary heap, so scheduling an event and
+// delivering the next one are O(log n) in the number of pending events (at
+// most one per blocked process)
+class event_queue_t {
+public:
+    void schedule(long long time, size_t context, int device) {
+        events.push_back({time, next_sequence++, context, device});
+        std::push_heap(events.begin(), events.end(), std::greater<sim_event_t>());
+    }
+
+    bool empty() const {
+        return events.empty();
+    }
+
+    size_t size() const {
+        return events.size();
+    }
+
+    //returns true if every event is for a context below `count` (checks a restored checkpoint)
+    bool contexts_below(size_t count) const {
+        return std::all_of(events.begin(), events.end(), [count](const sim_event_t& event) { return event.context < count; });
+    }
+
+    //The next event due (the queue must not be empty)
+    const sim_event_t& next() const {
+        return events.front();
+    }
+
+    void pop() {
+        std::pop_heap(events.begin(), events.end(), std::greater<sim_event_t>());
+        events.pop_back();
+    }
+
+    void save(checkpoint_writer_t& out) const {
+        out.put(next_sequence);
+        out.put<uint64_t>(events.size());
+        for(const auto& event : events) {
+            out.put(event.time);
+            out.put(event.sequence);
+            out.put<uint64_t>(event.context);
+            out.put(event.device);
+        }
+    }
+
+    //returns false if the checkpoint is malformed
+    bool load(checkpoint_reader_t& in) {
+        next_sequence = in.get<uint64_t>();
+        events.resize(in.get_count(28));
+        for(auto& event : events) {
+            event.time = in.get<long long>();
+            event.sequence = in.get<uint64_t>();
+            event.context = in.get<uint64_t>();
+            event.device = in.get<int>();
+        }
+        return in.ok() && std::is_heap(events.begin(), events.end(), std::greater<sim_event_t>());
+    }
+
+private:
+    std::vector<sim_event_t>    events;     //!< binary heap, earliest (time, sequence) first
+    uint64_t next_sequence = 0;
+};
+
+#endif
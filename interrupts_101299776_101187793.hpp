@@ -7,47 +7,39 @@
 #include<vector>
 #include<random>
 #include<utility>
+#include<tuple>
+#include<unordered_map>
+#include<filesystem>
 #include<sstream>
+#include<charconv>
+#include<string_view>
 #include<iomanip>
 #include <algorithm>
 #include<stdio.h>
+#include "partition_allocator.hpp"
+#include "sim_stats.hpp"
+#include "program_names.hpp"
+#include "timing_model.hpp"
+#include "tokenizer.hpp"
 
 #define ADDR_BASE   0
 #define VECTOR_SIZE 2
 
-#define FIND_VECTOR_TIME 1
-#define GET_ISR_TIME 1
-
-#define MEM_LIMIT   1
-
-
-struct memory_partition_t {
-    const unsigned int partition_number;
-    const unsigned int size;
-    std::string code;
-
-    memory_partition_t(unsigned int _pn, unsigned int _s, std::string _c):
-        partition_number(_pn), size(_s), code(_c) {}
-};
-
-memory_partition_t memory[] = {
-    memory_partition_t(1, 40, "empty"),
-    memory_partition_t(2, 25, "empty"),
-    memory_partition_t(3, 15, "empty"),
-    memory_partition_t(4, 10, "empty"),
-    memory_partition_t(5, 8, "empty"),
-    memory_partition_t(6, 2, "empty")
-};
 
 struct PCB{
     unsigned int    PID;
     int             PPID;
-    std::string     program_name;
+    program_id_t    program;        //!< interned program name, see program_name()
     unsigned int    size;
     int             partition_number;
+    int             priority = 0;   //!< used by the priority scheduler, lower runs first
+
+    PCB(unsigned int _pid, int _ppid, std::string_view _pn, unsigned int _size, int _part_num):
+        PID(_pid), PPID(_ppid), program(program_names().intern(_pn)), size(_size), partition_number(_part_num) {}
 
-    PCB(unsigned int _pid, int _ppid, std::string _pn, unsigned int _size, int _part_num):
-        PID(_pid), PPID(_ppid), program_name(_pn), size(_size), partition_number(_part_num) {}
+    const std::string& program_name() const {
+        return program_names().name(program);
+    }
 };
 
 
@@ -59,24 +51,66 @@ struct external_file{
     unsigned int    size;
 };
 
-//Allocates a program to memory (if there is space)
-//returns true if the allocation was sucessful, false if not.
-bool allocate_memory(PCB* current) {
-    for(int i = 5; i >= 0; i--) { //Start from smallest partition
-        //check is the code will fit and if the partition is empty
-        if(memory[i].size >= current->size && memory[i].code == "empty") {
-            current->partition_number = memory[i].partition_number;
-            memory[i].code = current->program_name;
-            return true;
-        }
-    }
-    return false;
-}
+// The vector table, device table and external files, loaded once by parse_args
+// and shared by reference by the whole simulation
+struct sim_config_t {
+    std::vector<std::string>    vectors;
+    std::vector<int>            delays;
+    std::vector<external_file>  external_files;
+    std::unordered_map<std::string, int> priorities;    //!< program name -> scheduling priority
+    std::vector<unsigned int>   partition_sizes = default_partition_sizes();
+    timing_model_t              timing = BUILT_IN_TIMING;   //!< cost of the interrupt and EXEC steps
+};
 
-//frees the memory given PCB.
-void free_memory(PCB* process) {
-    memory[process->partition_number - 1].code = "empty";
-    process->partition_number = -1;
+// What the system status file records at each FORK and EXEC
+enum class snapshot_policy_t {
+    FULL,       //!< the whole PCB table every time
+    DIFF,       //!< only the PCBs that changed since the previous snapshot
+    SAMPLE,     //!< the whole PCB table, every --snapshot-every'th time
+    OFF         //!< nothing
+};
+
+// Optional settings, given after the four input files as --name=value
+struct sim_options_t {
+    bool            async_output = false;       //!< --async-output: write the output files on a background thread
+    size_t          output_buffer = 64 * 1024;  //!< --output-buffer=<bytes>: size of each output file buffer
+    std::string     partitions_file;            //!< --partitions=<file>: partition sizes, one per line
+    placement_policy_t memory_policy = placement_policy_t::BEST_FIT; //!< --memory-policy=best-fit|first-fit|worst-fit|buddy
+    unsigned int    buddy_size = 0;             //!< --buddy-size=<Mb>: buddy mode memory (default: the partition table total)
+    unsigned int    buddy_min = 1;              //!< --buddy-min=<Mb>: smallest buddy block
+    std::string     scheduler = "legacy";       //!< --scheduler=legacy|fcfs|priority|rr
+    int             quantum = 0;                //!< --quantum=<ms>: time slice, 0 to run bursts to completion
+    std::string     priorities_file;            //!< --priorities=<file>: "program_name, priority" per line
+    bool            batch = false;              //!< --batch: the trace argument is a list of traces (or a directory of them)
+    std::string     batch_output = "batch_output"; //!< --batch-output=<dir>: where each trace's output files go
+    unsigned int    jobs = 0;                   //!< --jobs=<n>: batch worker threads, 0 for one per core
+    std::string     programs_dir = "programs/"; //!< --programs-dir=<dir>: where EXEC finds <program>.txt
+    std::string     stats_file = "sim_stats.json"; //!< --stats-file=<file>: where a -DSIM_STATS build writes its stats
+    bool            print_stats = false;        //!< --print-stats: print the program cache and memory statistics when the run ends
+    snapshot_policy_t snapshots = snapshot_policy_t::FULL; //!< --snapshots=full|diff|sample|off
+    unsigned int    snapshot_every = 10;        //!< --snapshot-every=<n>: sampling interval of --snapshots=sample
+    bool            async_io = false;           //!< --async-io: SYSCALLs block only the caller while the device works, the END_IO after it costs no device time again (not with the legacy scheduler)
+    std::string     checkpoint_file = "simulation.ckpt"; //!< --checkpoint=<file>: where --checkpoint-at saves the simulator state
+    long long       checkpoint_at = -1;         //!< --checkpoint-at=<ms>: save the state once the simulation reaches this time
+    bool            checkpoint_only = false;    //!< --checkpoint-only: stop the run once the checkpoint is saved
+    std::string     resume_file;                //!< --resume=<file>: continue a run from a checkpoint instead of from time 0
+    unsigned int    cores = 1;                  //!< --cores=<n>: simulated CPUs, each with its own run queue (not with the legacy scheduler)
+    int             migration_cost = 2;         //!< --migration-cost=<ms>: time a core takes to take in a process stolen from another
+    size_t          lookahead = 65536;          //!< --lookahead=<lines>: trace lines a streamed trace may read ahead to resolve a FORK
+    bool            memo = true;                //!< --memo=on|off: replay repeated runs of leaf programs instead of simulating them again
+    unsigned int    fork_workers = 0;           //!< --fork-workers=<n>: threads rendering the output of forked subtrees (legacy scheduler only)
+    size_t          fork_grain = 64;            //!< --fork-grain=<lines>: smallest child block handed to a fork worker
+    std::string     timing_file;                //!< --timing=<file>: "step, ms" per line, overriding the built-in timing model
+    std::string     time_profile_file;          //!< --time-profile=<file>: simulated time by process stack, in folded-stacks format
+    std::string     pid_summary_file;           //!< --pid-summary=<file>: CPU, ISR, context switch and load time of every PID
+    std::string     time_index_file;            //!< --time-index=<file>: state changes by time, for time_query
+    unsigned int    index_every = 256;          //!< --index-every=<n>: state changes between two snapshots of --time-index
+};
+
+//A trace given as "-" (standard input) or a FIFO is read as it is simulated
+//(see trace_stream_t) instead of being loaded first
+bool streamed_trace(const char* path) {
+    return std::string_view(path) == "-" || std::filesystem::is_fifo(path);
 }
 
 
@@ -86,17 +120,20 @@ void free_memory(PCB* process) {
 
 
 
+
+
 // Following function was taken from stackoverflow; helper function for splitting strings
-std::vector<std::string> split_delim(std::string input, std::string delim) {
+// (it now searches from the end of the previous token instead of erasing it, so
+// a line is scanned once)
+std::vector<std::string> split_delim(const std::string& input, const std::string& delim) {
     std::vector<std::string> tokens;
+    std::size_t start = 0;
     std::size_t pos = 0;
-    std::string token;
-    while ((pos = input.find(delim)) != std::string::npos) {
-        token = input.substr(0, pos);
-        tokens.push_back(token);
-        input.erase(0, pos + delim.length());
+    while ((pos = input.find(delim, start)) != std::string::npos) {
+        tokens.push_back(input.substr(start, pos - start));
+        start = pos + delim.length();
     }
-    tokens.push_back(input);
+    tokens.push_back(input.substr(start));
 
     return tokens;
 }
@@ -112,19 +149,23 @@ std::vector<std::string> split_delim(std::string input, std::string delim) {
  * 
  */
 std::tuple<std::vector<std::string>, std::vector<int>, std::vector<external_file>>parse_args(int argc, char** argv) {
-    if(argc != 5) {
+    if(argc < 5) {
         std::cout << "ERROR!\nExpected 4 argument, received " << argc - 1 << std::endl;
-        std::cout << "To run the program, do: ./interrutps <your_trace_file.txt> <your_vector_table.txt> <your_device_table.txt> <your_external_files.txt>" << std::endl;
+        std::cout << "To run the program, do: ./interrutps <your_trace_file.txt> <your_vector_table.txt> <your_device_table.txt> <your_external_files.txt> [options]" << std::endl;
         exit(1);
     }
 
     std::ifstream input_file;
-    input_file.open(argv[1]);
-    if (!input_file.is_open()) {
-        std::cerr << "Error: Unable to open file: " << argv[1] << std::endl;
-        exit(1);
+    //a directory of traces is fine in batch mode, and a streamed trace is
+    //only opened once (a FIFO would lose its writer)
+    if(!std::filesystem::is_directory(argv[1]) && !streamed_trace(argv[1])) {
+        input_file.open(argv[1]);
+        if (!input_file.is_open()) {
+            std::cerr << "Error: Unable to open file: " << argv[1] << std::endl;
+            exit(1);
+        }
+        input_file.close();
     }
-    input_file.close();
 
     input_file.open(argv[2]);
     if (!input_file.is_open()) {
@@ -149,7 +190,11 @@ std::tuple<std::vector<std::string>, std::vector<int>, std::vector<external_file
     }
 
     while(std::getline(input_file, duration)) {
-        delays.push_back(std::stoi(duration));
+        int delay;
+        if(!parse_int(duration.data(), duration.data() + duration.size(), delay)) {
+            delay = std::stoi(duration);
+        }
+        delays.push_back(delay);
     }
     input_file.close();
 
@@ -163,10 +208,18 @@ std::tuple<std::vector<std::string>, std::vector<int>, std::vector<external_file
     std::string file_content;
     while(std::getline(input_file, file_content)) {
         external_file entry;
-        auto file_info      = split_delim(file_content, ",");
-
-        entry.program_name  = file_info[0];
-        entry.size          = std::stoi(file_info[1]);
+        //"<program name>, <size>", read in place; anything else the old way
+        const char* line = file_content.data();
+        const char* comma = static_cast<const char*>(memchr(line, ',', file_content.size()));
+        int size;
+        if(comma && parse_int(comma + 1, line + file_content.size(), size)) {
+            entry.program_name  = std::string(line, comma - line);
+            entry.size          = size;
+        } else {
+            auto file_info      = split_delim(file_content, ",");
+            entry.program_name  = file_info[0];
+            entry.size          = std::stoi(file_info[1]);
+        }
         external_files.push_back(entry);
     }
 
@@ -176,6 +229,211 @@ std::tuple<std::vector<std::string>, std::vector<int>, std::vector<external_file
     return {vectors, delays, external_files};
 }
 
+/**
+ * \brief parse the optional CLI arguments
+ *
+ * Everything after the four input files is an option of the form --name or --name=value
+ * 
+ * @param argc number of command line arguments
+ * @param argv the command line arguments
+ * @return the parsed options
+ * 
+ */
+sim_options_t parse_options(int argc, char** argv) {
+    sim_options_t options;
+
+    for(int i = 5; i < argc; i++) {
+        std::string option(argv[i]);
+        std::string value;
+        auto equals = option.find('=');
+        if(equals != std::string::npos) {
+            value = option.substr(equals + 1);
+            option = option.substr(0, equals);
+        }
+
+        try {
+            if(option == "--async-output") {
+                options.async_output = true;
+            } else if(option == "--print-stats") {
+                options.print_stats = true;
+            } else if(option == "--output-buffer") {
+                options.output_buffer = std::stoul(value);
+            } else if(option == "--partitions") {
+                options.partitions_file = value;
+            } else if(option == "--memory-policy") {
+                if(!parse_placement_policy(value, options.memory_policy)) {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--buddy-size") {
+                options.buddy_size = std::stoul(value);
+            } else if(option == "--buddy-min") {
+                options.buddy_min = std::stoul(value);
+            } else if(option == "--scheduler") {
+                if(value != "legacy" && value != "fcfs" && value != "priority" && value != "rr") {
+                    throw std::invalid_argument(value);
+                }
+                options.scheduler = value;
+            } else if(option == "--quantum") {
+                options.quantum = std::stoi(value);
+            } else if(option == "--priorities") {
+                options.priorities_file = value;
+            } else if(option == "--batch") {
+                options.batch = true;
+            } else if(option == "--batch-output") {
+                options.batch_output = value;
+            } else if(option == "--jobs") {
+                options.jobs = std::stoul(value);
+            } else if(option == "--programs-dir") {
+                options.programs_dir = value;
+                if(!value.empty() && value.back() != '/') {
+                    options.programs_dir += '/';
+                }
+            } else if(option == "--stats-file") {
+                options.stats_file = value;
+            } else if(option == "--snapshots") {
+                if(value == "full") {
+                    options.snapshots = snapshot_policy_t::FULL;
+                } else if(value == "diff") {
+                    options.snapshots = snapshot_policy_t::DIFF;
+                } else if(value == "sample") {
+                    options.snapshots = snapshot_policy_t::SAMPLE;
+                } else if(value == "off") {
+                    options.snapshots = snapshot_policy_t::OFF;
+                } else {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--async-io") {
+                options.async_io = true;
+            } else if(option == "--checkpoint") {
+                options.checkpoint_file = value;
+                if(value.empty()) {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--checkpoint-at") {
+                options.checkpoint_at = std::stoll(value);
+                if(options.checkpoint_at < 0) {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--checkpoint-only") {
+                options.checkpoint_only = true;
+            } else if(option == "--resume") {
+                options.resume_file = value;
+                if(value.empty()) {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--cores") {
+                options.cores = std::stoul(value);
+                if(options.cores == 0) {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--migration-cost") {
+                options.migration_cost = std::stoi(value);
+                if(options.migration_cost < 0) {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--fork-workers") {
+                options.fork_workers = std::stoul(value);
+            } else if(option == "--fork-grain") {
+                options.fork_grain = std::stoul(value);
+            } else if(option == "--timing") {
+                options.timing_file = value;
+            } else if(option == "--time-profile") {
+                options.time_profile_file = value;
+            } else if(option == "--pid-summary") {
+                options.pid_summary_file = value;
+            } else if(option == "--time-index") {
+                options.time_index_file = value;
+                if(value.empty()) {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--index-every") {
+                options.index_every = std::stoul(value);
+                if(options.index_every == 0) {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--memo") {
+                if(value != "on" && value != "off") {
+                    throw std::invalid_argument(value);
+                }
+                options.memo = value == "on";
+            } else if(option == "--lookahead") {
+                options.lookahead = std::stoul(value);
+                if(options.lookahead == 0) {
+                    throw std::invalid_argument(value);
+                }
+            } else if(option == "--snapshot-every") {
+                options.snapshot_every = std::stoul(value);
+                if(options.snapshot_every == 0) {
+                    throw std::invalid_argument(value);
+                }
+            } else {
+                std::cerr << "Error: Unknown option: " << argv[i] << std::endl;
+                exit(1);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid value for option: " << argv[i] << std::endl;
+            exit(1);
+        }
+    }
+
+    //The legacy scheduler runs a forked child to completion, it cannot run
+    //anything else while a process waits for a device
+    if(options.async_io && options.scheduler == "legacy") {
+        std::cerr << "Error: --async-io needs a --scheduler other than legacy" << std::endl;
+        exit(1);
+    }
+    if(options.cores > 1 && options.scheduler == "legacy") {
+        std::cerr << "Error: --cores needs a --scheduler other than legacy" << std::endl;
+        exit(1);
+    }
+    //Only a legacy child runs from its FORK to its end without anything in between
+    if(options.fork_workers > 0 && options.scheduler != "legacy") {
+        std::cerr << "Error: --fork-workers needs the legacy scheduler" << std::endl;
+        exit(1);
+    }
+
+#ifdef SIM_FIXED_TIMING
+    //The timing model of this build is compiled into the simulator
+    if(!options.timing_file.empty()) {
+        std::cerr << "Error: --timing cannot be used with a fixed timing build (SIM_FIXED_TIMING)" << std::endl;
+        exit(1);
+    }
+#endif
+
+    //A checkpoint belongs to one run and its two output files
+    if(options.batch && (options.checkpoint_at >= 0 || !options.resume_file.empty())) {
+        std::cerr << "Error: --checkpoint-at and --resume cannot be used with --batch" << std::endl;
+        exit(1);
+    }
+    if(options.fork_workers > 0 && (options.checkpoint_at >= 0 || !options.resume_file.empty())) {
+        std::cerr << "Error: --checkpoint-at and --resume cannot be used with --fork-workers" << std::endl;
+        exit(1);
+    }
+    //The time before the checkpoint was charged by another run
+    if(!options.resume_file.empty() && (!options.time_profile_file.empty() || !options.pid_summary_file.empty())) {
+        std::cerr << "Error: --time-profile and --pid-summary cannot be used with --resume" << std::endl;
+        exit(1);
+    }
+    //The index follows one CPU, with every byte of its output
+    if(!options.time_index_file.empty() && (options.cores > 1 || options.fork_workers > 0)) {
+        std::cerr << "Error: --time-index cannot be used with --cores or --fork-workers" << std::endl;
+        exit(1);
+    }
+    if(options.checkpoint_only && options.checkpoint_at < 0) {
+        std::cerr << "Error: --checkpoint-only needs --checkpoint-at" << std::endl;
+        exit(1);
+    }
+
+    //A streamed trace is read once and is gone: there is nothing to check a
+    //checkpoint against, and no list of traces
+    if(streamed_trace(argv[1]) && (options.batch || options.checkpoint_at >= 0 || !options.resume_file.empty())) {
+        std::cerr << "Error: --batch, --checkpoint-at and --resume cannot be used with a streamed trace" << std::endl;
+        exit(1);
+    }
+
+    return options;
+}
+
 //Parces each trace and returns a tuple: {Tace activity, duration or interrupt number, program name (if applicable)}
 std::tuple<std::string, int, std::string> parse_trace(std::string trace) {
     //split line by ','
@@ -210,46 +468,6 @@ std::tuple<std::string, int, std::string> parse_trace(std::string trace) {
 
 
 
-//Default interrupt boilerplate
-std::pair<std::string, int> intr_boilerplate(int current_time, int intr_num, int context_save_time, std::vector<std::string> vectors) {
-
-    std::string execution = "";
-
-    execution += std::to_string(current_time) + ", " + std::to_string(1) + ", switch to kernel mode\n";
-    current_time++;
-
-    execution += std::to_string(current_time) + ", " + std::to_string(context_save_time) + ", context saved\n";
-    current_time += context_save_time;
-    
-    char vector_address_c[10];
-    sprintf(vector_address_c, "0x%04X", (ADDR_BASE + (intr_num * VECTOR_SIZE)));
-    std::string vector_address(vector_address_c);
-
-    execution += std::to_string(current_time) + ", " + std::to_string(1) + ", find vector " + std::to_string(intr_num) 
-                    + " in memory position " + vector_address + "\n";
-    current_time++;
-
-    execution += std::to_string(current_time) + ", " + std::to_string(1) + ", load address " + vectors.at(intr_num) + " into the PC\n";
-    current_time++;
-
-    return std::make_pair(execution, current_time);
-}
-
-//Writes a string to a file
-void write_output(std::string execution, const char* filename) {
-    std::ofstream output_file(filename);
-
-    if (output_file.is_open()) {
-        output_file << execution;
-        output_file.close();  // Close the file when done
-        std::cout << "File content overwritten successfully." << std::endl;
-    } else {
-        std::cerr << "Error opening file!" << std::endl;
-    }
-
-    std::cout << "Output generated in execution.txt" << std::endl;
-}
-
 //Helper function for a sanity check. Prints the external files table
 void print_external_files(std::vector<external_file> files) {
     const int tableWidth = 24;
@@ -282,71 +500,48 @@ void print_external_files(std::vector<external_file> files) {
     std::cout << "+" << std::setfill('-') << std::setw(tableWidth) << "+" << std::endl;
 }
 
-//This function takes as input: the current PCB and the waitqueue (which is a
-//std::vector of the PCB struct); the function returns the information as a table
-std::string print_PCB(PCB current, std::vector<PCB> _PCB) {
-    const int tableWidth = 55;
-
-    std::stringstream buffer;
-    
-    // Print top border
-    buffer << "+" << std::setfill('-') << std::setw(tableWidth) << "+" << std::endl;
-    
-    // Print headers
-    buffer << "|"
-              << std::setfill(' ') << std::setw(4) << "PID"
-              << std::setw(2) << "|"
-              << std::setfill(' ') << std::setw(12) << "program name"
-              << std::setw(2) << "|"
-              << std::setfill(' ') << std::setw(16) << "partition number"
-              << std::setw(2) << "|"
-              << std::setfill(' ') << std::setw(5) << "size"
-              << std::setw(2) << "|" 
-              << std::setfill(' ') << std::setw(8) << "state"
-              << std::setw(2) << "|" << std::endl;
-    
-    // Print separator
-    buffer << "+" << std::setfill('-') << std::setw(tableWidth) << "+" << std::endl;
-
-    buffer << "|"
-                  << std::setfill(' ') << std::setw(4) << current.PID
-                  << std::setw(2) << "|"
-                  << std::setw(12) << current.program_name
-                  << std::setw(2) << "|"
-                  << std::setw(16) << current.partition_number
-                  << std::setw(2) << "|"
-                  << std::setw(5) << current.size
-                  << std::setw(2) << "|"
-                  << std::setw(8) << "running"
-                  << std::setw(2) << "|" << std::endl;
-    
-    // Print each PCB entry
-    for (const auto& program : _PCB) {
-        buffer << "|"
-                  << std::setfill(' ') << std::setw(4) << program.PID
-                  << std::setw(2) << "|"
-                  << std::setw(12) << program.program_name
-                  << std::setw(2) << "|"
-                  << std::setw(16) << program.partition_number
-                  << std::setw(2) << "|"
-                  << std::setw(5) << program.size
-                  << std::setw(2) << "|"
-                  << std::setw(8) << "waiting"
-                  << std::setw(2) << "|" << std::endl;
+//Appends `text` right-aligned in a field of `width` characters, like std::setw
+void append_field(std::string& out, std::string_view text, size_t width) {
+    if(text.size() < width) {
+        out.append(width - text.size(), ' ');
     }
-    
-    // Print bottom border
-    buffer << "+" << std::setfill('-') << std::setw(tableWidth) << "+\n" << std::endl;
+    out.append(text);
+}
 
-    return buffer.str();
+void append_field(std::string& out, long long value, size_t width) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    append_field(out, std::string_view(digits, result.ptr - digits), width);
 }
 
+//Appends one row of the PCB table
+void format_PCB_row(std::string& out, const PCB& pcb, std::string_view state) {
+    out += '|';
+    append_field(out, pcb.PID, 4);
+    out += " |";
+    append_field(out, pcb.program_name(), 12);
+    out += " |";
+    append_field(out, pcb.partition_number, 16);
+    out += " |";
+    append_field(out, pcb.size, 5);
+    out += " |";
+    append_field(out, state, 8);
+    out += " |\n";
+}
+
+// Borders and header of the PCB table (55 characters wide)
+const std::string PCB_TABLE_BORDER = "+" + std::string(54, '-') + "+\n";
+const std::string PCB_TABLE_HEADER = PCB_TABLE_BORDER
+    + "| PID |program name |partition number | size |   state |\n"
+    + PCB_TABLE_BORDER;
+const std::string PCB_TABLE_FOOTER = "+" + std::string(53, '-') + "+\n\n";
+
 
 // Searches the external_files table and returns the size of the program
-unsigned int get_size(std::string name, std::vector<external_file> external_files) {
+unsigned int get_size(const std::string& name, const std::vector<external_file>& external_files) {
     int size = -1;
 
-    for (auto file : external_files) { 
+    for (const auto& file : external_files) { 
         if(file.program_name == name){
             size = file.size;
             break;
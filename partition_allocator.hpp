@@ -0,0 +1,534 @@
+#ifndef PARTITION_ALLOCATOR_HPP_
+#define PARTITION_ALLOCATOR_HPP_
+
+#include "checkpoint.hpp"
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Where a program is placed in memory
+enum class placement_policy_t {
+    BEST_FIT,   //!< smallest free partition that fits (ties: highest partition number)
+    FIRST_FIT,  //!< lowest numbered free partition that fits
+    WORST_FIT,  //!< largest free partition (ties: lowest partition number)
+    BUDDY       //!< dynamic partitioning, power-of-two blocks split and merged on demand
+};
+
+struct memory_partition_t {
+    const unsigned int partition_number;
+    const unsigned int size;
+    std::string code;
+
+    memory_partition_t(unsigned int _pn, unsigned int _s, std::string _c):
+        partition_number(_pn), size(_s), code(_c) {}
+};
+
+// Allocation counters, printed at the end of a run
+struct allocation_stats_t {
+    size_t          allocations = 0;
+    size_t          failures = 0;
+    size_t          fragmented_failures = 0;    //!< failures where enough memory was free, just not in one piece
+    size_t          frees = 0;
+};
+
+// The memory of the simulated machine.
+//
+// With a fixed partition table (best/first/worst fit) free partitions are kept
+// in a (size, partition) ordered set for best/worst fit and in a max-size
+// segment tree over partition numbers for first fit, so every allocation and
+// free is O(log n) in the number of partitions.
+//
+// In buddy mode the table describes nothing but the total memory: blocks of
+// buddy_min << k Mb are split and merged on demand, and a block's partition
+// number is its offset in units of buddy_min, starting from 1.
+struct partition_table_t {
+    placement_policy_t                  policy = placement_policy_t::BEST_FIT;
+    std::vector<memory_partition_t>     partitions;     //!< fixed partitions, partition n at index n - 1
+    std::vector<bool>                   occupied;
+    std::vector<unsigned int>           occupied_size;  //!< size of the program in each partition
+    std::set<std::pair<unsigned int, int>> free_by_size;//!< (size, -index) of every free fixed partition
+    std::vector<unsigned long long>     max_free;       //!< segment tree: largest free partition + 1 in each range (0: none)
+    size_t                              leaves = 1;
+
+    unsigned int                        buddy_size = 0; //!< total memory in buddy mode (a power of two)
+    unsigned int                        buddy_min = 1;  //!< smallest block in buddy mode
+    std::vector<std::set<unsigned int>> buddy_free;     //!< free block offsets, by order
+    std::map<unsigned int, std::pair<unsigned int, unsigned int>> buddy_used; //!< offset -> (order, program size)
+
+    unsigned int                        total_free = 0;
+    allocation_stats_t                  stats;
+
+    partition_table_t() = default;
+
+    partition_table_t(std::vector<unsigned int> sizes, placement_policy_t _policy, unsigned int _buddy_size = 0, unsigned int _buddy_min = 1):
+        policy(_policy) {
+        for(size_t i = 0; i < sizes.size(); i++) {
+            partitions.emplace_back(i + 1, sizes[i], "empty");
+        }
+
+        if(policy == placement_policy_t::BUDDY) {
+            init_buddy(sizes, _buddy_size, _buddy_min);
+            return;
+        }
+
+        occupied.assign(partitions.size(), false);
+        occupied_size.assign(partitions.size(), 0);
+        while(leaves < partitions.size()) {
+            leaves *= 2;
+        }
+        max_free.assign(2 * leaves, 0);
+        for(size_t i = 0; i < partitions.size(); i++) {
+            mark_free(i);
+        }
+    }
+
+    //Places a program of `size` Mb in memory
+    //returns the partition number, or -1 if there is no room for it
+    int allocate(unsigned int size, const std::string& program_name) {
+        int partition_number = policy == placement_policy_t::BUDDY ? allocate_buddy(size) : allocate_fixed(size, program_name);
+
+        if(partition_number < 0) {
+            stats.failures++;
+            if(total_free >= size) {
+                stats.fragmented_failures++;
+            }
+        } else {
+            stats.allocations++;
+        }
+        return partition_number;
+    }
+
+    //Frees the partition (or buddy block) with the given number
+    void release(int partition_number) {
+        if(partition_number < 1) {
+            return;
+        }
+        if(policy == placement_policy_t::BUDDY) {
+            release_buddy(partition_number);
+            return;
+        }
+
+        size_t index = partition_number - 1;
+        if(index >= partitions.size() || !occupied[index]) {
+            return;
+        }
+        partitions[index].code = "empty";
+        occupied[index] = false;
+        occupied_size[index] = 0;
+        mark_free(index);
+        stats.frees++;
+    }
+
+    //Calls on_partition(partition number, program size, program name) for every
+    //occupied partition (buddy blocks keep no program name)
+    template<typename on_partition_t>
+    void for_each_occupied(on_partition_t on_partition) const {
+        if(policy == placement_policy_t::BUDDY) {
+            for(const auto& [offset, block] : buddy_used) {
+                on_partition(static_cast<int>(offset / buddy_min + 1), block.second, std::string());
+            }
+            return;
+        }
+        for(size_t i = 0; i < partitions.size(); i++) {
+            if(occupied[i]) {
+                on_partition(static_cast<int>(partitions[i].partition_number), occupied_size[i], partitions[i].code);
+            }
+        }
+    }
+
+    //Memory lost inside allocated partitions (partition size - program size)
+    unsigned long internal_fragmentation() const {
+        unsigned long lost = 0;
+        if(policy == placement_policy_t::BUDDY) {
+            for(const auto& [offset, block] : buddy_used) {
+                lost += (buddy_min << block.first) - block.second;
+            }
+            return lost;
+        }
+        for(size_t i = 0; i < partitions.size(); i++) {
+            if(occupied[i]) {
+                lost += partitions[i].size - occupied_size[i];
+            }
+        }
+        return lost;
+    }
+
+    //Size of the largest program that could be placed right now
+    unsigned int largest_free() const {
+        if(policy == placement_policy_t::BUDDY) {
+            for(size_t order = buddy_free.size(); order-- > 0;) {
+                if(!buddy_free[order].empty()) {
+                    return buddy_min << order;
+                }
+            }
+            return 0;
+        }
+        return max_free.empty() || max_free[1] == 0 ? 0 : max_free[1] - 1;
+    }
+
+    //Writes the whole table to a checkpoint
+    void save(checkpoint_writer_t& out) const {
+        out.put(policy);
+        out.put<uint64_t>(partitions.size());
+        for(size_t i = 0; i < partitions.size(); i++) {
+            out.put(partitions[i].size);
+            out.put_string(partitions[i].code);
+            out.put<uint8_t>(occupied.empty() ? 0 : occupied[i]);
+            out.put(occupied.empty() ? 0u : occupied_size[i]);
+        }
+        out.put<uint64_t>(free_by_size.size());
+        for(const auto& [size, index] : free_by_size) {
+            out.put(size);
+            out.put(index);
+        }
+        out.put<uint64_t>(max_free.size());
+        for(auto value : max_free) {
+            out.put(value);
+        }
+        out.put<uint64_t>(leaves);
+
+        out.put(buddy_size);
+        out.put(buddy_min);
+        out.put<uint64_t>(buddy_free.size());
+        for(const auto& blocks : buddy_free) {
+            out.put<uint64_t>(blocks.size());
+            for(auto offset : blocks) {
+                out.put(offset);
+            }
+        }
+        out.put<uint64_t>(buddy_used.size());
+        for(const auto& [offset, block] : buddy_used) {
+            out.put(offset);
+            out.put(block.first);
+            out.put(block.second);
+        }
+
+        out.put(total_free);
+        out.put<uint64_t>(stats.allocations);
+        out.put<uint64_t>(stats.failures);
+        out.put<uint64_t>(stats.fragmented_failures);
+        out.put<uint64_t>(stats.frees);
+    }
+
+    //Restores a table saved by save(). The placement policy stays the one this
+    //table was created with, so a run can resume under another fixed-partition
+    //policy; fixed partitions and buddy memory cannot be swapped for each other.
+    //returns false if the checkpoint is malformed or the memory models differ
+    bool load(checkpoint_reader_t& in) {
+        placement_policy_t saved_policy = in.get<placement_policy_t>();
+        if((saved_policy == placement_policy_t::BUDDY) != (policy == placement_policy_t::BUDDY)) {
+            return false;
+        }
+
+        partitions.clear();
+        occupied.clear();
+        occupied_size.clear();
+        size_t count = in.get_count(13);
+        for(size_t i = 0; i < count; i++) {
+            unsigned int size = in.get<unsigned int>();
+            partitions.emplace_back(i + 1, size, in.get_string());
+            occupied.push_back(in.get<uint8_t>() != 0);
+            occupied_size.push_back(in.get<unsigned int>());
+        }
+        if(policy == placement_policy_t::BUDDY) {
+            occupied.clear();
+            occupied_size.clear();
+        }
+
+        free_by_size.clear();
+        count = in.get_count(8);
+        for(size_t i = 0; i < count; i++) {
+            unsigned int size = in.get<unsigned int>();
+            free_by_size.emplace(size, in.get<int>());
+        }
+        max_free.resize(in.get_count(8));
+        for(auto& value : max_free) {
+            value = in.get<unsigned long long>();
+        }
+        leaves = in.get<uint64_t>();
+
+        buddy_size = in.get<unsigned int>();
+        buddy_min = in.get<unsigned int>();
+        buddy_free.assign(in.get_count(8), {});
+        for(auto& blocks : buddy_free) {
+            count = in.get_count(4);
+            for(size_t i = 0; i < count; i++) {
+                blocks.insert(in.get<unsigned int>());
+            }
+        }
+        buddy_used.clear();
+        count = in.get_count(12);
+        for(size_t i = 0; i < count; i++) {
+            unsigned int offset = in.get<unsigned int>();
+            unsigned int order = in.get<unsigned int>();
+            buddy_used[offset] = {order, in.get<unsigned int>()};
+        }
+
+        total_free = in.get<unsigned int>();
+        stats.allocations = in.get<uint64_t>();
+        stats.failures = in.get<uint64_t>();
+        stats.fragmented_failures = in.get<uint64_t>();
+        stats.frees = in.get<uint64_t>();
+        if(!in.ok()) {
+            return false;
+        }
+        return policy == placement_policy_t::BUDDY ? buddy_consistent() : fixed_consistent();
+    }
+
+private:
+    //returns true if the free set and segment tree of a loaded table match its
+    //occupied partitions, so allocations cannot index past the table
+    bool fixed_consistent() const {
+        if(leaves == 0 || (leaves & (leaves - 1)) != 0 || leaves < partitions.size() || max_free.size() != 2 * leaves) {
+            return false;
+        }
+        std::set<std::pair<unsigned int, int>> expected;
+        unsigned long long free_total = 0;
+        for(size_t i = 0; i < leaves; i++) {
+            unsigned long long value = 0;
+            if(i < partitions.size() && !occupied[i]) {
+                expected.emplace(partitions[i].size, -static_cast<int>(i));
+                value = partitions[i].size + 1ULL;
+                free_total += partitions[i].size;
+            }
+            if(max_free[leaves + i] != value) {
+                return false;
+            }
+        }
+        for(size_t node = 1; node < leaves; node++) {
+            if(max_free[node] != std::max(max_free[2 * node], max_free[2 * node + 1])) {
+                return false;
+            }
+        }
+        return expected == free_by_size && free_total == total_free;
+    }
+
+    //returns true if every buddy block of a loaded table lies inside memory
+    bool buddy_consistent() const {
+        if(buddy_min == 0 || buddy_free.empty() || buddy_free.size() > 32
+           || (static_cast<unsigned long long>(buddy_min) << (buddy_free.size() - 1)) != buddy_size) {
+            return false;
+        }
+        for(size_t order = 0; order < buddy_free.size(); order++) {
+            for(auto offset : buddy_free[order]) {
+                if(offset % (buddy_min << order) != 0 || offset >= buddy_size) {
+                    return false;
+                }
+            }
+        }
+        for(const auto& [offset, block] : buddy_used) {
+            if(block.first >= buddy_free.size() || offset % (buddy_min << block.first) != 0 || offset >= buddy_size) {
+                return false;
+            }
+        }
+        return total_free <= buddy_size;
+    }
+
+    void update_tree(size_t index, unsigned long long value) {
+        size_t node = leaves + index;
+        max_free[node] = value;
+        for(node /= 2; node > 0; node /= 2) {
+            max_free[node] = std::max(max_free[2 * node], max_free[2 * node + 1]);
+        }
+    }
+
+    void mark_free(size_t index) {
+        free_by_size.emplace(partitions[index].size, -static_cast<int>(index));
+        update_tree(index, partitions[index].size + 1ULL);
+        total_free += partitions[index].size;
+    }
+
+    void mark_used(size_t index, unsigned int size, const std::string& program_name) {
+        free_by_size.erase({partitions[index].size, -static_cast<int>(index)});
+        update_tree(index, 0);
+        total_free -= partitions[index].size;
+        partitions[index].code = program_name;
+        occupied[index] = true;
+        occupied_size[index] = size;
+    }
+
+    int allocate_fixed(unsigned int size, const std::string& program_name) {
+        int index = -1;
+
+        switch(policy) {
+            case placement_policy_t::BEST_FIT: {
+                auto fit = free_by_size.lower_bound({size, INT_MIN});
+                if(fit != free_by_size.end()) {
+                    index = -fit->second;
+                }
+                break;
+            }
+            case placement_policy_t::WORST_FIT: {
+                if(!free_by_size.empty()) {
+                    auto largest = std::prev(free_by_size.end());
+                    if(largest->first >= size) {
+                        index = -largest->second;
+                    }
+                }
+                break;
+            }
+            case placement_policy_t::FIRST_FIT: {
+                unsigned long long needed = size + 1ULL;
+                if(max_free.empty() || max_free[1] < needed) {
+                    break;
+                }
+                size_t node = 1;
+                while(node < leaves) {
+                    node = max_free[2 * node] >= needed ? 2 * node : 2 * node + 1;
+                }
+                index = node - leaves;
+                break;
+            }
+            default:
+                break;
+        }
+
+        if(index < 0) {
+            return -1;
+        }
+        mark_used(index, size, program_name);
+        return partitions[index].partition_number;
+    }
+
+    void init_buddy(const std::vector<unsigned int>& sizes, unsigned int total, unsigned int min_block) {
+        if(total == 0) {
+            for(auto size : sizes) {
+                total += size;
+            }
+        }
+        buddy_min = min_block ? min_block : 1;
+        buddy_size = buddy_min;
+        while(buddy_size < total) {
+            buddy_size *= 2;
+        }
+
+        size_t orders = 1;
+        while((buddy_min << (orders - 1)) < buddy_size) {
+            orders++;
+        }
+        buddy_free.assign(orders, {});
+        buddy_free[orders - 1].insert(0);
+        total_free = buddy_size;
+    }
+
+    int allocate_buddy(unsigned int size) {
+        if(size > buddy_size) {
+            return -1;
+        }
+        size_t order = 0;
+        while((buddy_min << order) < size) {
+            order++;
+        }
+
+        size_t available = order;
+        while(available < buddy_free.size() && buddy_free[available].empty()) {
+            available++;
+        }
+        if(available == buddy_free.size()) {
+            return -1;
+        }
+
+        // Split the block down to the requested order, freeing the upper halves
+        unsigned int offset = *buddy_free[available].begin();
+        buddy_free[available].erase(buddy_free[available].begin());
+        while(available > order) {
+            available--;
+            buddy_free[available].insert(offset + (buddy_min << available));
+        }
+
+        buddy_used[offset] = {order, size};
+        total_free -= buddy_min << order;
+        return offset / buddy_min + 1;
+    }
+
+    void release_buddy(int partition_number) {
+        unsigned int offset = (partition_number - 1) * buddy_min;
+        auto used = buddy_used.find(offset);
+        if(used == buddy_used.end()) {
+            return;
+        }
+        size_t order = used->second.first;
+        buddy_used.erase(used);
+        total_free += buddy_min << order;
+        stats.frees++;
+
+        // Merge with the buddy for as long as it is free too
+        while(order + 1 < buddy_free.size()) {
+            unsigned int buddy = offset ^ (buddy_min << order);
+            auto found = buddy_free[order].find(buddy);
+            if(found == buddy_free[order].end()) {
+                break;
+            }
+            buddy_free[order].erase(found);
+            offset = std::min(offset, buddy);
+            order++;
+        }
+        buddy_free[order].insert(offset);
+    }
+};
+
+//The partition table of the assignment: 6 fixed partitions, 100 Mb in total
+std::vector<unsigned int> default_partition_sizes() {
+    return {40, 25, 15, 10, 8, 2};
+}
+
+//Maps a --memory-policy value to its policy
+//returns false if the name is not a known policy
+bool parse_placement_policy(const std::string& name, placement_policy_t& policy) {
+    if(name == "best-fit") {
+        policy = placement_policy_t::BEST_FIT;
+    } else if(name == "first-fit") {
+        policy = placement_policy_t::FIRST_FIT;
+    } else if(name == "worst-fit") {
+        policy = placement_policy_t::WORST_FIT;
+    } else if(name == "buddy") {
+        policy = placement_policy_t::BUDDY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//Reads a partition table: one partition size (in Mb) per line, the partition
+//number being the line number (starting from 1), just like the device table
+std::vector<unsigned int> load_partition_sizes(const std::string& filename) {
+    std::ifstream input_file(filename);
+    if (!input_file.is_open()) {
+        std::cerr << "Error: Unable to open file: " << filename << std::endl;
+        exit(1);
+    }
+
+    std::vector<unsigned int> sizes;
+    std::string size;
+    while(std::getline(input_file, size)) {
+        if(size.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        try {
+            sizes.push_back(std::stoul(size));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid partition size: " << size << std::endl;
+            exit(1);
+        }
+    }
+    input_file.close();
+
+    return sizes;
+}
+
+//Prints the allocation and fragmentation statistics of the run
+void print_memory_stats(const partition_table_t& memory) {
+    std::cout << "Memory: " << memory.stats.allocations << " allocation(s), "
+              << memory.stats.frees << " free(s), "
+              << memory.stats.failures << " failure(s) ("
+              << memory.stats.fragmented_failures << " with enough free memory)" << std::endl;
+    std::cout << "Memory: " << memory.total_free << " Mb free, largest free block "
+              << memory.largest_free() << " Mb, internal fragmentation "
+              << memory.internal_fragmentation() << " Mb" << std::endl;
+}
+
+#endif
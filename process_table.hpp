@@ -0,0 +1,356 @@
+#ifndef PROCESS_TABLE_HPP_
+#define PROCESS_TABLE_HPP_
+
+#include "interrupts_101299776_101187793.hpp"
+#include "checkpoint.hpp"
+#include <algorithm>
+#include <climits>
+#include <optional>
+#include <vector>
+
+//Writes a PCB to a checkpoint, with its program by name (ids are only valid
+//within one process)
+void save_pcb(checkpoint_writer_t& out, const PCB& pcb) {
+    out.put(pcb.PID);
+    out.put(pcb.PPID);
+    out.put_string(pcb.program_name());
+    out.put(pcb.size);
+    out.put(pcb.partition_number);
+    out.put(pcb.priority);
+}
+
+PCB load_pcb(checkpoint_reader_t& in) {
+    unsigned int pid = in.get<unsigned int>();
+    int ppid = in.get<int>();
+    std::string program_name = in.get_string();
+    unsigned int size = in.get<unsigned int>();
+    PCB pcb(pid, ppid, program_name, size, in.get<int>());
+    pcb.priority = in.get<int>();
+    return pcb;
+}
+
+void save_optional_pcb(checkpoint_writer_t& out, const std::optional<PCB>& pcb) {
+    out.put<uint8_t>(pcb.has_value());
+    if(pcb) {
+        save_pcb(out, *pcb);
+    }
+}
+
+std::optional<PCB> load_optional_pcb(checkpoint_reader_t& in) {
+    if(in.get<uint8_t>() == 0) {
+        return std::nullopt;
+    }
+    return load_pcb(in);
+}
+
+// A table of PCBs indexed by PID. Entries are linked in table order (the order
+// the status output lists them in), so adding a PCB at the end, removing one
+// and updating one in place are all O(1).
+//
+// Every change can be journaled: rollback(mark) undoes the changes made since
+// mark() in reverse order, which puts removed entries back at their old
+// position. The legacy scheduler uses this to give each forked child its own
+// view of the table without copying it: a child runs to completion before its
+// parent resumes, so the parent's table is the child's with the child's
+// changes undone.
+//
+// With track_changes on, the table also lists the PIDs it changed since the
+// last take_changes(), so a diff of the table does not have to look at the
+// PCBs nothing touched.
+class process_table_t {
+public:
+    static const unsigned int NO_PID = UINT_MAX;
+
+    size_t size() const {
+        return fixed.size() + count;
+    }
+
+    bool contains(unsigned int pid) const {
+        return pid >= first_pid && pid - first_pid < entries.size() && entry(pid).pcb.has_value();
+    }
+
+    //returns the PCB with this PID, or nullptr if it is not in the table
+    const PCB* find(unsigned int pid) const {
+        if(contains(pid)) {
+            return &*entry(pid).pcb;
+        }
+        if(pid < first_pid) {
+            for(const PCB& pcb : fixed) {
+                if(pcb.PID == pid) {
+                    return &pcb;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    //Adds a PCB at the end of the table, moving it there if its PID is already in it
+    void push_back(const PCB& pcb) {
+        remove(pcb.PID);
+        if(pcb.PID - first_pid >= entries.size()) {
+            entries.resize(pcb.PID - first_pid + 1);
+        }
+        entry_t& entry = this->entry(pcb.PID);
+        entry.pcb = pcb;
+        link(pcb.PID, tail, NO_PID);
+        touch(pcb.PID);
+        if(journaling) {
+            journal.push_back({change_t::ADDED, pcb.PID, std::nullopt, NO_PID, NO_PID});
+        }
+    }
+
+    //Removes the PCB with this PID, if it is in the table
+    void remove(unsigned int pid) {
+        if(!contains(pid)) {
+            return;
+        }
+        entry_t& entry = this->entry(pid);
+        if(journaling) {
+            journal.push_back({change_t::REMOVED, pid, std::move(entry.pcb), entry.prev, entry.next});
+        }
+        unlink(pid);
+        entry.pcb.reset();
+        touch(pid);
+    }
+
+    //Replaces the PCB with the same PID, keeping its place in the table
+    void update(const PCB& pcb) {
+        if(!contains(pcb.PID)) {
+            push_back(pcb);
+            return;
+        }
+        entry_t& entry = this->entry(pcb.PID);
+        if(journaling) {
+            journal.push_back({change_t::UPDATED, pcb.PID, entry.pcb, NO_PID, NO_PID});
+        }
+        entry.pcb = pcb;
+        touch(pcb.PID);
+    }
+
+    //Starts or stops listing the PIDs changed. Starting lists every PID in the
+    //table, since whatever diffs the table has not seen it yet.
+    void track(bool on) {
+        if(on && !track_changes) {
+            for_each([this](const PCB& pcb) {
+                changed.push_back(pcb.PID);
+            });
+        }
+        if(!on) {
+            changed.clear();
+        }
+        track_changes = on;
+    }
+
+    //Moves the PIDs changed since the last call into `pids` (in no particular
+    //order, possibly more than once)
+    void take_changes(std::vector<unsigned int>& pids) {
+        pids.swap(changed);
+        changed.clear();
+    }
+
+    //Calls visit(pcb) for every PCB, in table order
+    template<typename visitor_t>
+    void for_each(visitor_t visit) const {
+        for(const PCB& pcb : fixed) {
+            visit(pcb);
+        }
+        for(unsigned int pid = head; pid != NO_PID; pid = entry(pid).next) {
+            visit(*entry(pid).pcb);
+        }
+    }
+
+    //returns a table with the same PCBs in the same order and an empty journal,
+    //for a run that only adds, moves or removes PIDs from `first_pid` on (every
+    //PID in the table now is smaller). The PCBs it has now stay ahead of the
+    //rest as a fixed list, so the copy does not grow with the PIDs handed out.
+    process_table_t copy_live(unsigned int first_pid) const {
+        process_table_t copy;
+        copy.journaling = journaling;
+        copy.track_changes = track_changes;
+        copy.changed = changed;
+        copy.first_pid = first_pid;
+        for_each([&copy](const PCB& pcb) {
+            copy.fixed.push_back(pcb);
+        });
+        return copy;
+    }
+
+    //Position in the journal to roll back to
+    size_t mark() const {
+        return journal.size();
+    }
+
+    //Undoes every change made since `position` was marked, newest first
+    void rollback(size_t position) {
+        while(journal.size() > position) {
+            journal_entry_t& change = journal.back();
+            entry_t& entry = this->entry(change.pid);
+            switch(change.change) {
+                case change_t::ADDED:
+                    unlink(change.pid);
+                    entry.pcb.reset();
+                    break;
+                case change_t::REMOVED:
+                    entry.pcb = std::move(change.pcb);
+                    link(change.pid, change.prev, change.next);
+                    break;
+                case change_t::UPDATED:
+                    entry.pcb = std::move(change.pcb);
+                    break;
+            }
+            touch(change.pid);
+            journal.pop_back();
+        }
+    }
+
+    //Writes the table, its links and its journal to a checkpoint
+    void save(checkpoint_writer_t& out) const {
+        out.put<uint8_t>(journaling);
+        out.put<uint64_t>(entries.size());
+        for(const auto& entry : entries) {
+            save_optional_pcb(out, entry.pcb);
+            out.put(entry.prev);
+            out.put(entry.next);
+        }
+        out.put<uint64_t>(journal.size());
+        for(const auto& change : journal) {
+            out.put(change.change);
+            out.put(change.pid);
+            save_optional_pcb(out, change.pcb);
+            out.put(change.prev);
+            out.put(change.next);
+        }
+        out.put(head);
+        out.put(tail);
+        out.put<uint64_t>(count);
+        out.put<uint8_t>(track_changes);
+        out.put<uint64_t>(changed.size());
+        for(auto pid : changed) {
+            out.put(pid);
+        }
+    }
+
+    //returns false if the checkpoint is malformed
+    bool load(checkpoint_reader_t& in) {
+        journaling = in.get<uint8_t>() != 0;
+        entries.resize(in.get_count(9));
+        for(auto& entry : entries) {
+            entry.pcb = load_optional_pcb(in);
+            entry.prev = in.get<unsigned int>();
+            entry.next = in.get<unsigned int>();
+        }
+        journal.clear();
+        size_t changes = in.get_count(14);
+        for(size_t i = 0; i < changes; i++) {
+            change_t change = in.get<change_t>();
+            unsigned int pid = in.get<unsigned int>();
+            std::optional<PCB> pcb = load_optional_pcb(in);
+            unsigned int prev = in.get<unsigned int>();
+            journal.push_back({change, pid, std::move(pcb), prev, in.get<unsigned int>()});
+            if(pid >= entries.size()) {
+                in.fail();
+            }
+        }
+        head = in.get<unsigned int>();
+        tail = in.get<unsigned int>();
+        count = in.get<uint64_t>();
+        track_changes = in.get<uint8_t>() != 0;
+        changed.resize(in.get_count(4));
+        for(auto& pid : changed) {
+            pid = in.get<unsigned int>();
+            if(pid >= entries.size()) {
+                in.fail();
+            }
+        }
+
+        //Every link must stay inside the table, and every PCB in the entry of its PID
+        auto valid = [this](unsigned int pid) { return pid == NO_PID || pid < entries.size(); };
+        for(size_t pid = 0; pid < entries.size(); pid++) {
+            const entry_t& entry = entries[pid];
+            if(!valid(entry.prev) || !valid(entry.next) || (entry.pcb && entry.pcb->PID != pid)) {
+                in.fail();
+            }
+        }
+        for(const auto& change : journal) {
+            if(!valid(change.prev) || !valid(change.next) || (change.pcb && change.pcb->PID != change.pid)) {
+                in.fail();
+            }
+        }
+        if(!in.ok() || !valid(head) || !valid(tail)) {
+            return false;
+        }
+
+        //and the links must chain every PCB from head to tail, once each
+        size_t linked = 0;
+        unsigned int prev = NO_PID;
+        for(unsigned int pid = head; pid != NO_PID; pid = entries[pid].next) {
+            if(linked++ == entries.size() || !entries[pid].pcb || entries[pid].prev != prev) {
+                return false;
+            }
+            prev = pid;
+        }
+        size_t pcbs = std::count_if(entries.begin(), entries.end(), [](const entry_t& entry) { return entry.pcb.has_value(); });
+        return prev == tail && linked == count && linked == pcbs;
+    }
+
+    bool                journaling = false;     //!< record changes so they can be rolled back
+    bool                track_changes = false;  //!< list the PIDs changed, for take_changes()
+
+private:
+    struct entry_t {
+        std::optional<PCB>  pcb;                //!< empty when the PID is not in the table
+        unsigned int        prev = NO_PID;
+        unsigned int        next = NO_PID;
+    };
+
+    enum class change_t : uint8_t { ADDED, REMOVED, UPDATED };
+
+    struct journal_entry_t {
+        change_t            change;
+        unsigned int        pid;
+        std::optional<PCB>  pcb;                //!< the PCB before the change (REMOVED, UPDATED)
+        unsigned int        prev;               //!< neighbours before a removal
+        unsigned int        next;
+    };
+
+    void touch(unsigned int pid) {
+        if(track_changes) {
+            changed.push_back(pid);
+        }
+    }
+
+    //Links an entry between two neighbours (NO_PID for the ends of the table)
+    void link(unsigned int pid, unsigned int prev, unsigned int next) {
+        entry(pid).prev = prev;
+        entry(pid).next = next;
+        (prev == NO_PID ? head : entry(prev).next) = pid;
+        (next == NO_PID ? tail : entry(next).prev) = pid;
+        count++;
+    }
+
+    void unlink(unsigned int pid) {
+        entry_t& entry = this->entry(pid);
+        (entry.prev == NO_PID ? head : this->entry(entry.prev).next) = entry.next;
+        (entry.next == NO_PID ? tail : this->entry(entry.next).prev) = entry.prev;
+        count--;
+    }
+
+    entry_t& entry(unsigned int pid) {
+        return entries[pid - first_pid];
+    }
+
+    const entry_t& entry(unsigned int pid) const {
+        return entries[pid - first_pid];
+    }
+
+    std::vector<entry_t>            entries;    //!< by PID, from first_pid on
+    std::vector<PCB>                fixed;      //!< copy_live: the PCBs ahead of every entry, never changed
+    unsigned int                    first_pid = 0;
+    std::vector<journal_entry_t>    journal;
+    std::vector<unsigned int>       changed;    //!< PIDs changed since take_changes(), with track_changes
+    unsigned int                    head = NO_PID;
+    unsigned int                    tail = NO_PID;
+    size_t                          count = 0;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef PROGRAM_CACHE_HPP_
+#define PROGRAM_CACHE_HPP_
+
+#include "trace_binary.hpp"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// A program loaded from programs/<name>.txt: its compiled instructions and the
+// view every EXEC of that program runs over. Images are never modified after
+// loading, so one image is shared by every process that execs the program.
+struct program_image_t {
+    const std::string   program_name;
+    compiled_trace_t    trace;
+    trace_view_t        view;
+
+    program_image_t(std::string _pn, compiled_trace_t _trace):
+        program_name(std::move(_pn)), trace(std::move(_trace)), view(&trace) {}
+
+    program_image_t(const program_image_t&) = delete;
+    program_image_t& operator=(const program_image_t&) = delete;
+};
+
+//Loads a program file: text programs are compiled, binary ones are mapped and
+//run in place (see trace_binary.hpp)
+//returns nullptr if the file cannot be opened
+std::shared_ptr<const program_image_t> load_program(const std::string& program_name, const std::string& path) {
+    compiled_trace_t trace;
+    if(!load_trace_file(path, trace)) {
+        return nullptr;
+    }
+    return std::make_shared<program_image_t>(program_name, std::move(trace));
+}
+
+// Program images keyed by program name. Each program is loaded and compiled the
+// first time it is exec'd; every later EXEC of the same program is a hit and
+// does not touch the filesystem. Programs that could not be opened are
+// remembered too (as nullptr) so a missing file is only looked up once.
+//
+// A program is loaded outside the lock: the first get() of a name leaves a
+// future for it in `loading`, and other threads asking for the same program
+// wait on that future while those asking for any other go on.
+struct program_cache_t {
+    using image_ptr_t = std::shared_ptr<const program_image_t>;
+
+    std::string                                                             directory;
+    std::unordered_map<std::string, image_ptr_t>                            images;
+    std::unordered_map<std::string, std::shared_future<image_ptr_t>>        loading;    //!< programs being loaded, by name
+    std::mutex                                                              lock;
+    std::unordered_set<std::string>                                         uncounted;  //!< loaded by an uncounted get(), its miss not counted yet
+    size_t                                                                  hits = 0;
+    size_t                                                                  misses = 0;
+
+    explicit program_cache_t(std::string _directory = "programs/"):
+        directory(std::move(_directory)) {}
+
+    //A get() that is not `counted` leaves the counters as they are: it repeats
+    //an EXEC that is counted elsewhere (see simulator_t::render_subtree)
+    //returns the image of the program, or nullptr if programs/<name>.txt cannot be opened
+    image_ptr_t get(const std::string& program_name, bool counted = true) {
+        std::promise<image_ptr_t> promise;
+        std::shared_future<image_ptr_t> pending;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            auto found = images.find(program_name);
+            auto loader = loading.find(program_name);
+            if(found != images.end() || loader != loading.end()) {
+                if(counted) {
+                    //The first counted EXEC of a program is its miss, whoever loaded it
+                    if(!uncounted.empty() && uncounted.erase(program_name)) {
+                        misses++;
+                    } else {
+                        hits++;
+                    }
+                }
+                if(found != images.end()) {
+                    return found->second;
+                }
+                pending = loader->second;
+            } else {
+                if(counted) {
+                    misses++;
+                } else {
+                    uncounted.insert(program_name);
+                }
+                loading.emplace(program_name, promise.get_future().share());
+            }
+        }
+
+        //Another thread is loading it
+        if(pending.valid()) {
+            return pending.get();
+        }
+
+        image_ptr_t image;
+        try {
+            image = load_program(program_name, directory + program_name + ".txt");
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(lock);
+            loading.erase(program_name);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            images.emplace(program_name, image);
+            loading.erase(program_name);
+        }
+        promise.set_value(image);
+        return image;
+    }
+
+    //returns the loaded program whose view is `view`, or nullptr
+    image_ptr_t owner(const trace_view_t* view) {
+        std::lock_guard<std::mutex> guard(lock);
+        for(const auto& [program_name, image] : images) {
+            if(image && &image->view == view) {
+                return image;
+            }
+        }
+        return nullptr;
+    }
+};
+
+//Prints the cache hit/miss counters
+void print_cache_stats(const program_cache_t& cache) {
+    std::cout << "Program cache: " << cache.hits << " hit(s), " << cache.misses << " miss(es)" << std::endl;
+}
+
+#endif
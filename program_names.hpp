@@ -0,0 +1,78 @@
+#ifndef PROGRAM_NAMES_HPP_
+#define PROGRAM_NAMES_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+typedef uint32_t program_id_t;
+
+// Program names interned once for the whole process, so a PCB refers to its
+// program by id and copying a PCB copies no string.
+//
+// Names are never removed and never move: they are stored in chunks of
+// doubling size, so name() reads without locking while other threads (batch
+// workers) intern new names. Only intern() takes the lock, and an id can only
+// be obtained from intern(), which orders every read after the write.
+class program_names_t {
+public:
+    program_names_t() = default;
+    program_names_t(const program_names_t&) = delete;
+    program_names_t& operator=(const program_names_t&) = delete;
+
+    //returns the id of the name, adding it if it is new
+    program_id_t intern(std::string_view name) {
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto found = ids.find(name);
+        if(found != ids.end()) {
+            return found->second;
+        }
+
+        program_id_t id = count++;
+        auto [chunk, offset] = locate(id);
+        if(!chunks[chunk]) {
+            chunks[chunk] = std::make_unique<std::string[]>(FIRST_CHUNK << chunk);
+        }
+        std::string& stored = chunks[chunk][offset];
+        stored = name;
+        ids.emplace(stored, id);
+        return id;
+    }
+
+    const std::string& name(program_id_t id) const {
+        auto [chunk, offset] = locate(id);
+        return chunks[chunk][offset];
+    }
+
+private:
+    static const size_t FIRST_CHUNK = 64;
+    static const size_t CHUNKS = 26;    //!< room for about 4 billion names
+
+    //Chunk k holds ids [FIRST_CHUNK * (2^k - 1), FIRST_CHUNK * (2^(k+1) - 1))
+    static std::pair<size_t, size_t> locate(program_id_t id) {
+        size_t chunk = 0;
+        size_t first = 0;
+        while(id >= first + (FIRST_CHUNK << chunk)) {
+            first += FIRST_CHUNK << chunk;
+            chunk++;
+        }
+        return {chunk, id - first};
+    }
+
+    std::unique_ptr<std::string[]>                      chunks[CHUNKS];
+    std::unordered_map<std::string_view, program_id_t>  ids;    //!< views into the chunks
+    program_id_t                                        count = 0;
+    std::mutex                                          lock;
+};
+
+//The process-wide program name table
+program_names_t& program_names() {
+    static program_names_t names;
+    return names;
+}
+
+#endif
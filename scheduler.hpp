@@ -0,0 +1,307 @@
+#ifndef SCHEDULER_HPP_
+#define SCHEDULER_HPP_
+
+#include "checkpoint.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Counters kept by every scheduler, printed at the end of a run
+struct schedule_stats_t {
+    size_t          dispatches = 0;
+    size_t          preemptions = 0;
+    size_t          finished = 0;
+    long long       total_turnaround = 0;   //!< sum of (exit time - creation time) of finished processes
+    size_t          io_requests = 0;        //!< --async-io: SYSCALLs the caller blocked on
+    long long       idle_time = 0;          //!< --async-io: time the CPU waited with every process blocked
+};
+
+// Picks which ready process runs next. Processes are identified by the index of
+// their context in the simulator. The simulator calls the scheduler whenever it
+// logs "scheduler called" (FORK and EXEC), when the running process ends and,
+// with a quantum, when the running process used up its time slice.
+class scheduler_t {
+public:
+    virtual ~scheduler_t() = default;
+
+    virtual const char* name() const = 0;
+
+    //Makes a process ready. `arrival` is the time the process was created.
+    virtual void add(size_t context, int priority, long long arrival) = 0;
+
+    //Removes and returns the next process to run (the queue must not be empty)
+    virtual size_t pick() = 0;
+
+    //The process pick() would return, left in the queue
+    virtual size_t peek() const = 0;
+
+    virtual bool empty() const = 0;
+    virtual size_t size() const = 0;
+
+    //returns true if every queued context is below `count` (checks a restored checkpoint)
+    virtual bool contexts_below(size_t count) const = 0;
+
+    //The legacy scheduler reproduces the original simulator: the child of a FORK
+    //runs to completion while every other process keeps its own PCB table
+    virtual bool legacy() const {
+        return false;
+    }
+
+    //Writes the counters and the ready processes to a checkpoint (the quantum
+    //is an option, a resumed run takes its own)
+    void save(checkpoint_writer_t& out) const {
+        out.put_string(name());
+        out.put<uint64_t>(stats.dispatches);
+        out.put<uint64_t>(stats.preemptions);
+        out.put<uint64_t>(stats.finished);
+        out.put(stats.total_turnaround);
+        out.put<uint64_t>(stats.io_requests);
+        out.put(stats.idle_time);
+        save_ready(out);
+    }
+
+    //returns false if the checkpoint is malformed or was taken under another policy
+    bool load(checkpoint_reader_t& in) {
+        if(in.get_string() != name()) {
+            return false;
+        }
+        stats.dispatches = in.get<uint64_t>();
+        stats.preemptions = in.get<uint64_t>();
+        stats.finished = in.get<uint64_t>();
+        stats.total_turnaround = in.get<long long>();
+        stats.io_requests = in.get<uint64_t>();
+        stats.idle_time = in.get<long long>();
+        return load_ready(in) && in.ok();
+    }
+
+    int                 quantum = 0;    //!< CPU time slice in ms, 0 to let bursts run to completion
+    schedule_stats_t    stats;
+
+protected:
+    virtual void save_ready(checkpoint_writer_t& out) const = 0;
+    virtual bool load_ready(checkpoint_reader_t& in) = 0;
+};
+
+// The original behaviour: the most recently readied process runs first, so a
+// forked child runs to completion before its parent resumes
+class legacy_scheduler_t : public scheduler_t {
+public:
+    const char* name() const override { return "legacy"; }
+    bool legacy() const override { return true; }
+
+    void add(size_t context, int, long long) override {
+        stack.push_back(context);
+    }
+
+    size_t pick() override {
+        size_t context = stack.back();
+        stack.pop_back();
+        return context;
+    }
+
+    size_t peek() const override {
+        return stack.back();
+    }
+
+    bool empty() const override { return stack.empty(); }
+    size_t size() const override { return stack.size(); }
+
+    bool contexts_below(size_t count) const override {
+        return std::all_of(stack.begin(), stack.end(), [count](size_t context) { return context < count; });
+    }
+
+protected:
+    void save_ready(checkpoint_writer_t& out) const override {
+        out.put<uint64_t>(stack.size());
+        for(auto context : stack) {
+            out.put<uint64_t>(context);
+        }
+    }
+
+    bool load_ready(checkpoint_reader_t& in) override {
+        stack.resize(in.get_count(8));
+        for(auto& context : stack) {
+            context = in.get<uint64_t>();
+        }
+        return true;
+    }
+
+private:
+    std::vector<size_t> stack;
+};
+
+// Binary heap of ready processes ordered by a policy key, then by the order in
+// which they became ready. Every operation is O(log n) in the number of ready processes.
+class heap_scheduler_t : public scheduler_t {
+public:
+    void add(size_t context, int priority, long long arrival) override {
+        ready.push_back({key(priority, arrival), next_sequence++, context});
+        std::push_heap(ready.begin(), ready.end(), std::greater<ready_entry_t>());
+    }
+
+    size_t pick() override {
+        std::pop_heap(ready.begin(), ready.end(), std::greater<ready_entry_t>());
+        size_t context = ready.back().context;
+        ready.pop_back();
+        return context;
+    }
+
+    size_t peek() const override {
+        return ready.front().context;
+    }
+
+    bool empty() const override { return ready.empty(); }
+    size_t size() const override { return ready.size(); }
+
+    bool contexts_below(size_t count) const override {
+        return std::all_of(ready.begin(), ready.end(), [count](const ready_entry_t& entry) { return entry.context < count; });
+    }
+
+protected:
+    virtual long long key(int priority, long long arrival) const = 0;
+
+    //The heap is saved as laid out, so a resumed run breaks ties the same way
+    void save_ready(checkpoint_writer_t& out) const override {
+        out.put(next_sequence);
+        out.put<uint64_t>(ready.size());
+        for(const auto& entry : ready) {
+            out.put(entry.key);
+            out.put(entry.sequence);
+            out.put<uint64_t>(entry.context);
+        }
+    }
+
+    bool load_ready(checkpoint_reader_t& in) override {
+        next_sequence = in.get<uint64_t>();
+        ready.resize(in.get_count(24));
+        for(auto& entry : ready) {
+            entry.key = in.get<long long>();
+            entry.sequence = in.get<uint64_t>();
+            entry.context = in.get<uint64_t>();
+        }
+        return std::is_heap(ready.begin(), ready.end(), std::greater<ready_entry_t>());
+    }
+
+private:
+    struct ready_entry_t {
+        long long   key;
+        uint64_t    sequence;
+        size_t      context;
+
+        bool operator>(const ready_entry_t& other) const {
+            return key != other.key ? key > other.key : sequence > other.sequence;
+        }
+    };
+
+    std::vector<ready_entry_t>  ready;      //!< binary heap, smallest (key, sequence) first
+    uint64_t                    next_sequence = 0;
+};
+
+// First come, first served: processes run in creation order
+class fcfs_scheduler_t : public heap_scheduler_t {
+public:
+    const char* name() const override { return "fcfs"; }
+protected:
+    long long key(int, long long arrival) const override { return arrival; }
+};
+
+// Lowest priority number first, creation order among equal priorities
+class priority_scheduler_t : public heap_scheduler_t {
+public:
+    const char* name() const override { return "priority"; }
+protected:
+    long long key(int priority, long long) const override { return priority; }
+};
+
+// Round robin: ready processes take turns in the order they became ready
+class round_robin_scheduler_t : public heap_scheduler_t {
+public:
+    const char* name() const override { return "rr"; }
+protected:
+    long long key(int, long long) const override { return 0; }
+};
+
+//Creates the scheduler for a --scheduler value
+//returns nullptr if the name is not a known policy
+std::unique_ptr<scheduler_t> make_scheduler(const std::string& name, int quantum) {
+    std::unique_ptr<scheduler_t> scheduler;
+    if(name == "legacy") {
+        scheduler = std::make_unique<legacy_scheduler_t>();
+    } else if(name == "fcfs") {
+        scheduler = std::make_unique<fcfs_scheduler_t>();
+    } else if(name == "priority") {
+        scheduler = std::make_unique<priority_scheduler_t>();
+    } else if(name == "rr") {
+        scheduler = std::make_unique<round_robin_scheduler_t>();
+    } else {
+        return nullptr;
+    }
+    if(!scheduler->legacy()) {
+        scheduler->quantum = quantum;
+    }
+    return scheduler;
+}
+
+//Reads the program priorities: "program_name, priority" per line, lower numbers run first
+std::unordered_map<std::string, int> load_priorities(const std::string& filename) {
+    std::ifstream input_file(filename);
+    if (!input_file.is_open()) {
+        std::cerr << "Error: Unable to open file: " << filename << std::endl;
+        exit(1);
+    }
+
+    std::unordered_map<std::string, int> priorities;
+    std::string line;
+    while(std::getline(input_file, line)) {
+        auto comma = line.find(',');
+        if(comma == std::string::npos) {
+            continue;
+        }
+        try {
+            priorities[line.substr(0, comma)] = std::stoi(line.substr(comma + 1));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid priority: " << line << std::endl;
+            exit(1);
+        }
+    }
+    input_file.close();
+
+    return priorities;
+}
+
+//Prints what the scheduler did during the run, with the counters of `stats`
+//(those of every core on a multi-core run)
+void print_schedule_stats(const scheduler_t& scheduler, const schedule_stats_t& stats) {
+    if(scheduler.legacy()) {
+        return;
+    }
+    std::cout << "Scheduler (" << scheduler.name();
+    if(scheduler.quantum > 0) {
+        std::cout << ", quantum " << scheduler.quantum << " ms";
+    }
+    std::cout << "): " << stats.dispatches << " dispatch(es), "
+              << stats.preemptions << " preemption(s), "
+              << stats.finished << " process(es) finished";
+    if(stats.finished > 0) {
+        std::cout << ", average turnaround "
+                  << stats.total_turnaround / static_cast<long long>(stats.finished) << " ms";
+    }
+    std::cout << std::endl;
+    if(stats.io_requests > 0) {
+        std::cout << "Scheduler: " << stats.io_requests << " asynchronous I/O request(s), CPU idle for "
+                  << stats.idle_time << " ms" << std::endl;
+    }
+}
+
+//Prints what the scheduler did during the run
+void print_schedule_stats(const scheduler_t& scheduler) {
+    print_schedule_stats(scheduler, scheduler.stats);
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef SEGMENT_MEMO_HPP_
+#define SEGMENT_MEMO_HPP_
+
+#include "trace_ir.hpp"
+#include "output_sink.hpp"
+#include "sim_stats.hpp"
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The execution.txt lines of one run of an EXEC'd program, with the times taken
+// out so the lines can be written again from any start time
+struct replay_segment_t {
+    std::string             text;       //!< every line, each event without its leading time
+    std::vector<int>        times;      //!< time of each event, from the start of the run
+    std::vector<uint32_t>   starts;     //!< where each event starts in text
+    int                     duration;   //!< time from the start of the run to its end
+};
+
+// Memoized runs of leaf programs: programs that only run CPU bursts and
+// SYSCALL/END_IO interrupts. Such a program does not touch memory, the PCB
+// table or the system status file. Without preemption or background I/O its
+// lines depend only on its instructions and the device delays, vectors and
+// event prefix of the simulator, which do not change during a run. So one memo
+// per simulator, keyed by program, is enough: the first run is recorded and
+// every later one is replayed, shifted to its start time.
+class segment_memo_t {
+public:
+    //returns the recorded run of a program, or nullptr
+    const replay_segment_t* find(program_id_t program) const {
+        auto segment = segments.find(program);
+        return segment == segments.end() ? nullptr : &segment->second;
+    }
+
+    //returns true if every instruction of the view is a CPU burst, a SYSCALL,
+    //an END_IO or an IF/ENDIF marker, which is all a replay may stand for
+    bool leaf(program_id_t program, const trace_view_t& view) {
+        auto known = leaves.find(program);
+        if(known != leaves.end()) {
+            return known->second;
+        }
+        bool is_leaf = view.size() > 0;
+        for(size_t i = 0; i < view.size() && is_leaf; i++) {
+            switch(view[i].activity) {
+            case activity_t::CPU:
+            case activity_t::SYSCALL:
+            case activity_t::END_IO:
+            case activity_t::IF_CHILD:
+            case activity_t::IF_PARENT:
+            case activity_t::ENDIF:
+                break;
+            default:
+                is_leaf = false;
+            }
+        }
+        leaves.emplace(program, is_leaf);
+        return is_leaf;
+    }
+
+    //Starts copying what is written to `out`, for a run of `program` starting
+    //at `time` by the process in `slot`
+    void begin(output_sink_t& out, program_id_t program, size_t slot, int time) {
+        recorder = slot;
+        recorded_program = program;
+        start_time = time;
+        captured.clear();
+        out.capture = &captured;
+    }
+
+    //returns true while a run is being recorded
+    bool recording() const {
+        return recorder != NO_RECORDING;
+    }
+
+    //returns true while a run by the process in `slot` is being recorded
+    bool recording_by(size_t slot) const {
+        return recorder == slot;
+    }
+
+    //Drops the recording (the run was interleaved with something else)
+    void abort(output_sink_t& out) {
+        out.capture = nullptr;
+        recorder = NO_RECORDING;
+    }
+
+    //Ends the recording at `time` and keeps the run, if every line of it is an
+    //event of the form "<time>, <duration>, ..."
+    void end(output_sink_t& out, int time) {
+        out.capture = nullptr;
+        recorder = NO_RECORDING;
+
+        replay_segment_t segment;
+        segment.duration = time - start_time;
+        segment.text.reserve(captured.size());
+        size_t position = 0;
+        while(position < captured.size()) {
+            size_t end_of_line = captured.find('\n', position);
+            end_of_line = end_of_line == std::string::npos ? captured.size() : end_of_line + 1;
+            if(end_of_line - position > 1) {
+                long long event_time = 0;
+                const char* line_end = captured.data() + end_of_line;
+                auto parsed = std::from_chars(captured.data() + position, line_end, event_time);
+                if(parsed.ec != std::errc() || line_end - parsed.ptr < 2 || std::string_view(parsed.ptr, 2) != ", ") {
+                    return;
+                }
+                segment.times.push_back(event_time - start_time);
+                segment.starts.push_back(segment.text.size());
+                position = parsed.ptr - captured.data();
+            } else if(segment.starts.empty()) {
+                return;
+            }
+            segment.text.append(captured, position, end_of_line - position);
+            position = end_of_line;
+        }
+        if(segment.starts.empty()) {
+            return;
+        }
+        SIM_STAT_COUNT(MEMO_RECORDINGS, 1);
+        segments.emplace(recorded_program, std::move(segment));
+    }
+
+    //Writes a recorded run again, starting at `time`
+    //returns the time the run ends
+    static int replay(output_sink_t& out, const replay_segment_t& segment, int time) {
+        SIM_STAT_COUNT(MEMO_REPLAYS, 1);
+        for(size_t event = 0; event < segment.starts.size(); event++) {
+            size_t end = event + 1 < segment.starts.size() ? segment.starts[event + 1] : segment.text.size();
+            out.append_number(static_cast<long long>(time) + segment.times[event]);
+            out.append(segment.text.data() + segment.starts[event], end - segment.starts[event]);
+        }
+        return time + segment.duration;
+    }
+
+private:
+    static const size_t NO_RECORDING = static_cast<size_t>(-1);
+
+    std::unordered_map<program_id_t, replay_segment_t>  segments;
+    std::unordered_map<program_id_t, bool>              leaves;
+    std::string                                         captured;
+    size_t                                              recorder = NO_RECORDING;    //!< slot of the process whose run is being recorded
+    program_id_t                                        recorded_program{};
+    int                                                 start_time = 0;
+};
+
+#endif
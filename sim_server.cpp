@@ -0,0 +1,580 @@
+/**
+ *
+ * @file sim_server.cpp
+ *
+ * Serves simulations over a Unix domain socket. The vector table, device table,
+ * external files and every program in the programs directory are loaded once,
+ * when the server starts, and again only when one of them changes on disk.
+ * Each connection is one job, run in a child process forked from the warm
+ * server, so a job pays neither for process startup nor for loading the
+ * configuration, and a job that fails cannot take the server down. While no
+ * job comes in, the server still reaps finished jobs and reloads a changed
+ * configuration once a second.
+ *
+ * Usage: ./sim_server <vector_table.txt> <device_table.txt> <external_files.txt>
+ *        --socket=<path> [simulator options]
+ * The simulator options are the defaults of every job. --jobs=<n> caps the
+ * jobs running at once (0 for one per core).
+ *
+ * A job is a few request lines, then the reply streams back as the job runs:
+ *
+ *   TRACE <path>                 the trace to simulate, read by the server, or
+ *   TRACE_TEXT <n>               followed by the n bytes of the trace itself
+ *   OPTION <--name=value>        any number of simulator options for this job
+ *   RUN                          starts the job
+ *
+ *   EXECUTION <n>                followed by n more bytes of execution.txt
+ *   STATUS <n>                   followed by n more bytes of system_status.txt
+ *   LOG <n>                      followed by the n bytes of the job's messages
+ *   DONE <time>                  the job ended at simulation time <time>
+ *   ERROR <message>              the job could not run (last line sent)
+ *
+ */
+
+#include "interrupts_101299776_101187793.hpp"
+#include "simulator.hpp"
+#include "time_profile.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <csignal>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// A file the warm state was loaded from, with its modification time then
+struct watched_file_t {
+    std::string                         path;
+    std::filesystem::file_time_type     modified;
+};
+
+// Everything a job would otherwise load itself: the tables, the partition,
+// priority and timing files of the default options, and the program images
+struct warm_state_t {
+    sim_config_t                        config;
+    std::unique_ptr<program_cache_t>    programs;
+    std::vector<watched_file_t>         watched;
+};
+
+//returns the modification time of a file, or the minimum if it is gone
+std::filesystem::file_time_type modified_time(const std::string& path) {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    return error ? std::filesystem::file_time_type::min() : time;
+}
+
+//returns the files a warm state is loaded from, with their modification times
+//now (the programs directory too, for programs added or removed)
+std::vector<watched_file_t> watched_files(const std::vector<char*>& table_args, const sim_options_t& defaults) {
+    std::vector<watched_file_t> watched;
+    for(size_t i = 2; i < table_args.size(); i++) {
+        watched.push_back({table_args[i], modified_time(table_args[i])});
+    }
+    for(const std::string* file : {&defaults.priorities_file, &defaults.partitions_file, &defaults.timing_file}) {
+        if(!file->empty()) {
+            watched.push_back({*file, modified_time(*file)});
+        }
+    }
+    watched.push_back({defaults.programs_dir, modified_time(defaults.programs_dir)});
+    std::error_code listing_error;
+    for(const auto& entry : std::filesystem::directory_iterator(defaults.programs_dir, listing_error)) {
+        if(entry.path().extension() == ".txt") {
+            watched.push_back({entry.path().string(), modified_time(entry.path().string())});
+        }
+    }
+    return watched;
+}
+
+//Loads the tables and every program of the programs directory. Like the
+//simulator, it exits on a file it cannot read (see reload_warm_state).
+warm_state_t load_warm_state(const std::vector<char*>& table_args, const sim_options_t& defaults) {
+    warm_state_t loaded;
+    auto [vectors, delays, external_files] = parse_args(table_args.size(), const_cast<char**>(table_args.data()));
+    loaded.config = sim_config_t{vectors, delays, external_files, {}};
+    if(!defaults.priorities_file.empty()) {
+        loaded.config.priorities = load_priorities(defaults.priorities_file);
+    }
+    if(!defaults.partitions_file.empty()) {
+        loaded.config.partition_sizes = load_partition_sizes(defaults.partitions_file);
+    }
+    if(!defaults.timing_file.empty()) {
+        loaded.config.timing = load_timing_model(defaults.timing_file);
+    }
+
+    //Every program is loaded now (uncounted, so the jobs' cache counters are
+    //their own)
+    loaded.programs = std::make_unique<program_cache_t>(defaults.programs_dir);
+    std::error_code listing_error;
+    for(const auto& entry : std::filesystem::directory_iterator(defaults.programs_dir, listing_error)) {
+        if(entry.path().extension() == ".txt") {
+            loaded.programs->get(entry.path().stem().string(), false);
+        }
+    }
+
+    return loaded;
+}
+
+//Tries load_warm_state in a child process
+//returns true if the files load
+bool warm_state_loads(const std::vector<char*>& table_args, const sim_options_t& defaults) {
+    std::cout.flush();
+    std::fflush(nullptr);
+    pid_t child = fork();
+    if(child == 0) {
+        std::cerr.rdbuf(nullptr);
+        load_warm_state(table_args, defaults);
+        _exit(0);
+    }
+    int status = 0;
+    return child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+//Copies the files of the warm state into `directory`: `tables` and `options`
+//name the copies
+//returns false if one of them cannot be copied
+bool copy_warm_files(const std::vector<char*>& table_args, const sim_options_t& defaults,
+                     const std::filesystem::path& directory, std::vector<std::string>& tables, sim_options_t& options) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::create_directories(directory / "programs", error);
+    if(error) {
+        return false;
+    }
+    auto copy = [&](const std::string& from, const std::string& name) {
+        std::string to = (directory / name).string();
+        std::error_code copy_error;
+        fs::copy_file(from, to, fs::copy_options::overwrite_existing, copy_error);
+        error = error ? error : copy_error;
+        return to;
+    };
+    tables.clear();
+    for(size_t i = 2; i < table_args.size(); i++) {
+        tables.push_back(copy(table_args[i], "table" + std::to_string(i)));
+    }
+    options = defaults;
+    if(!options.priorities_file.empty()) {
+        options.priorities_file = copy(options.priorities_file, "priorities");
+    }
+    if(!options.partitions_file.empty()) {
+        options.partitions_file = copy(options.partitions_file, "partitions");
+    }
+    if(!options.timing_file.empty()) {
+        options.timing_file = copy(options.timing_file, "timing");
+    }
+    options.programs_dir = (directory / "programs").string() + "/";
+    std::error_code listing_error;
+    for(const auto& entry : fs::directory_iterator(defaults.programs_dir, listing_error)) {
+        if(entry.path().extension() == ".txt") {
+            copy(entry.path().string(), "programs/" + entry.path().filename().string());
+        }
+    }
+    return !error;
+}
+
+//Reloads the warm state. The files are copied aside first and the copies are
+//tried in a child process, so the server loads the very bytes that loaded in
+//the child, and a file caught halfway through being rewritten cannot stop it.
+//A set of files that does not load is not tried again until one changes.
+//returns false (and keeps the previous state) if the files do not load
+bool reload_warm_state(warm_state_t& warm, const std::vector<char*>& table_args, const sim_options_t& defaults) {
+    std::vector<watched_file_t> watched = watched_files(table_args, defaults);
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::temp_directory_path(error) / ("sim_server." + std::to_string(getpid()));
+    std::filesystem::remove_all(directory, error);
+
+    std::vector<std::string> tables;
+    sim_options_t options;
+    bool loads = copy_warm_files(table_args, defaults, directory, tables, options);
+    std::vector<char*> copied_args = {table_args[0], table_args[1]};
+    for(auto& table : tables) {
+        copied_args.push_back(table.data());
+    }
+    loads = loads && warm_state_loads(copied_args, options);
+    if(loads) {
+        warm = load_warm_state(copied_args, options);
+        warm.programs->directory = defaults.programs_dir;
+    }
+    warm.watched = std::move(watched);
+    std::filesystem::remove_all(directory, error);
+    return loads;
+}
+
+//returns true if a file the warm state came from changed since it was loaded
+bool warm_state_stale(const warm_state_t& warm) {
+    for(const auto& file : warm.watched) {
+        if(modified_time(file.path) != file.modified) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Writes all of `data` to the socket
+//returns false once the client is gone
+bool send_all(int fd, const char* data, size_t size) {
+    while(size > 0) {
+        ssize_t sent = write(fd, data, size);
+        if(sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if(sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// The reply side of a job. The two output sinks may send from their writer
+// threads (--async-output), so frames are sent one at a time.
+class job_reply_t {
+public:
+    explicit job_reply_t(int _fd): fd(_fd) {}
+
+    //Sends "<kind> <size>\n" and the bytes. A client that hung up ends the job.
+    void frame(const char* kind, const char* data, size_t size) {
+        std::lock_guard<std::mutex> guard(lock);
+        std::string header = std::string(kind) + " " + std::to_string(size) + "\n";
+        if(!send_all(fd, header.data(), header.size()) || !send_all(fd, data, size)) {
+            _exit(1);
+        }
+    }
+
+    void line(const std::string& text) {
+        std::lock_guard<std::mutex> guard(lock);
+        std::string message = text + "\n";
+        if(!send_all(fd, message.data(), message.size())) {
+            _exit(1);
+        }
+    }
+
+private:
+    int         fd;
+    std::mutex  lock;
+};
+
+// Reads the request lines (and the bytes of TRACE_TEXT) from the socket
+class request_reader_t {
+public:
+    explicit request_reader_t(int _fd): fd(_fd) {}
+
+    //returns false if the client hung up first
+    bool line(std::string& text) {
+        while(true) {
+            size_t newline = buffer.find('\n', position);
+            if(newline != std::string::npos) {
+                text = buffer.substr(position, newline - position);
+                position = newline + 1;
+                return true;
+            }
+            if(!fill()) {
+                return false;
+            }
+        }
+    }
+
+    //returns false if the client hung up first
+    bool bytes(size_t size, std::string& text) {
+        while(buffer.size() - position < size) {
+            if(!fill()) {
+                return false;
+            }
+        }
+        text = buffer.substr(position, size);
+        position += size;
+        return true;
+    }
+
+private:
+    bool fill() {
+        char chunk[64 * 1024];
+        ssize_t received;
+        do {
+            received = read(fd, chunk, sizeof(chunk));
+        } while(received < 0 && errno == EINTR);
+        if(received <= 0) {
+            return false;
+        }
+        buffer.erase(0, position);
+        position = 0;
+        buffer.append(chunk, received);
+        return true;
+    }
+
+    int         fd;
+    std::string buffer;
+    size_t      position = 0;
+};
+
+// What a job says on std::cerr goes back to its client: as LOG before DONE,
+// or as the ERROR of a job that exited early (an invalid option exits)
+std::ostringstream  job_messages;
+job_reply_t*        job_in_progress = nullptr;
+
+void report_unfinished_job() {
+    if(job_in_progress) {
+        std::string message = job_messages.str();
+        while(!message.empty() && message.back() == '\n') {
+            message.pop_back();
+        }
+        std::replace(message.begin(), message.end(), '\n', ' ');
+        job_in_progress->line("ERROR " + (message.empty() ? std::string("job failed") : message));
+    }
+}
+
+//Runs one job in the forked child, then exits
+void serve_job(int client, const std::vector<char*>& server_args, const sim_options_t& defaults, const warm_state_t& warm) {
+    job_reply_t reply(client);
+    std::cerr.rdbuf(job_messages.rdbuf());
+    job_in_progress = &reply;
+    std::atexit(report_unfinished_job);
+
+    request_reader_t request(client);
+    std::string trace_path;
+    std::string trace_text;
+    bool has_text = false;
+    std::vector<std::string> job_options;
+    std::string line;
+    while(true) {
+        if(!request.line(line)) {
+            _exit(1);
+        }
+        if(!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if(line == "RUN") {
+            break;
+        } else if(line.rfind("TRACE ", 0) == 0) {
+            trace_path = line.substr(6);
+        } else if(line.rfind("TRACE_TEXT ", 0) == 0) {
+            size_t size = 0;
+            try {
+                size = std::stoul(line.substr(11));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid request line: " << line << std::endl;
+                exit(1);
+            }
+            if(!request.bytes(size, trace_text)) {
+                _exit(1);
+            }
+            has_text = true;
+        } else if(line.rfind("OPTION ", 0) == 0) {
+            job_options.push_back(line.substr(7));
+        } else {
+            std::cerr << "Error: Invalid request line: " << line << std::endl;
+            exit(1);
+        }
+    }
+    if(trace_path.empty() == !has_text) {
+        std::cerr << "Error: A job needs one TRACE or TRACE_TEXT" << std::endl;
+        exit(1);
+    }
+    if(!trace_path.empty() && streamed_trace(trace_path.c_str())) {
+        std::cerr << "Error: The server does not read streamed traces" << std::endl;
+        exit(1);
+    }
+
+    //The job's options go after the server's, so they override them
+    std::vector<char*> args = server_args;
+    if(!trace_path.empty()) {
+        args[1] = trace_path.data();
+    }
+    for(auto& option : job_options) {
+        args.push_back(option.data());
+    }
+    sim_options_t options = parse_options(args.size(), args.data());
+    if(options.batch || options.checkpoint_at >= 0 || !options.resume_file.empty()) {
+        std::cerr << "Error: --batch, --checkpoint-at and --resume cannot be used with the server" << std::endl;
+        exit(1);
+    }
+
+    sim_config_t config = warm.config;
+    if(options.priorities_file != defaults.priorities_file) {
+        config.priorities = options.priorities_file.empty() ? decltype(config.priorities)() : load_priorities(options.priorities_file);
+    }
+    if(options.partitions_file != defaults.partitions_file) {
+        config.partition_sizes = options.partitions_file.empty() ? default_partition_sizes() : load_partition_sizes(options.partitions_file);
+    }
+    if(options.timing_file != defaults.timing_file) {
+        config.timing = options.timing_file.empty() ? BUILT_IN_TIMING : load_timing_model(options.timing_file);
+    }
+    std::unique_ptr<program_cache_t> own_programs;
+    program_cache_t* programs = warm.programs.get();
+    if(options.programs_dir != defaults.programs_dir) {
+        own_programs = std::make_unique<program_cache_t>(options.programs_dir);
+        programs = own_programs.get();
+    }
+
+    compiled_trace_t trace_file;
+    if(has_text) {
+        trace_file = compile_trace(trace_text.data(), trace_text.size());
+        trace_text = std::string();
+    } else if(!load_trace_file(trace_path, trace_file)) {
+        std::cerr << "Error: Unable to load trace: " << trace_path << std::endl;
+        exit(1);
+    }
+    trace_view_t trace_view(&trace_file);
+
+    int end_time;
+    {
+        output_sink_t execution([&](const char* data, size_t size) { reply.frame("EXECUTION", data, size); },
+                                options.output_buffer, options.async_output);
+        output_sink_t system_status([&](const char* data, size_t size) { reply.frame("STATUS", data, size); },
+                                    options.output_buffer, options.async_output);
+        simulator_t simulator(config, options, *programs);
+        if(!options.time_index_file.empty()) {
+            simulator.index = open_time_index(options);
+        }
+        end_time = simulator.run(trace_view, execution, system_status);
+        execution.close();
+        system_status.close();
+        if(simulator.profile) {
+            write_time_profile(*simulator.profile, options);
+        }
+        if(simulator.index && !simulator.index->close(end_time)) {
+            std::cerr << "Error writing file " << options.time_index_file << "!" << std::endl;
+        }
+    }
+
+    job_in_progress = nullptr;
+    std::string messages = job_messages.str();
+    if(!messages.empty()) {
+        reply.frame("LOG", messages.data(), messages.size());
+    }
+    reply.line("DONE " + std::to_string(end_time));
+    close(client);
+    exit(0);
+}
+
+volatile sig_atomic_t stopping = 0;
+
+void stop_server(int) {
+    stopping = 1;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 4) {
+        std::cout << "To run the server, do: ./sim_server <your_vector_table.txt> <your_device_table.txt> <your_external_files.txt> "
+                  << "--socket=<path> [simulator options]" << std::endl;
+        return 1;
+    }
+
+    //--socket is ours, everything else is a default simulator option. Like
+    //the generator, there is no trace yet where parse_args wants one.
+    std::string socket_path;
+    std::vector<char*> server_args = {argv[0], argv[1], argv[1], argv[2], argv[3]};
+    for(int i = 4; i < argc; i++) {
+        std::string arg(argv[i]);
+        if(arg.rfind("--socket=", 0) == 0) {
+            socket_path = arg.substr(9);
+        } else {
+            server_args.push_back(argv[i]);
+        }
+    }
+    if(socket_path.empty()) {
+        std::cerr << "Error: the server needs --socket=<path>" << std::endl;
+        return 1;
+    }
+    sim_options_t defaults = parse_options(server_args.size(), server_args.data());
+    if(defaults.batch || defaults.checkpoint_at >= 0 || !defaults.resume_file.empty()) {
+        std::cerr << "Error: --batch, --checkpoint-at and --resume cannot be used with the server" << std::endl;
+        return 1;
+    }
+
+    std::vector<char*> table_args(server_args.begin(), server_args.begin() + 5);
+    std::vector<watched_file_t> watched = watched_files(table_args, defaults);
+    warm_state_t warm = load_warm_state(table_args, defaults);
+    warm.watched = std::move(watched);
+    print_external_files(warm.config.external_files);
+    std::cout << "Programs loaded: " << warm.programs->images.size() << std::endl;
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if(server < 0 || socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Unable to create socket: " << socket_path << std::endl;
+        return 1;
+    }
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if(bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(server, 64) < 0) {
+        std::cerr << "Error: Unable to listen on socket: " << socket_path << std::endl;
+        return 1;
+    }
+
+    //A job whose client hangs up gets EPIPE rather than the signal; SIGINT and
+    //SIGTERM stop the server (poll is not restarted) and remove the socket
+    std::signal(SIGPIPE, SIG_IGN);
+    struct sigaction stop{};
+    stop.sa_handler = stop_server;
+    sigaction(SIGINT, &stop, nullptr);
+    sigaction(SIGTERM, &stop, nullptr);
+
+    unsigned int max_jobs = defaults.jobs ? defaults.jobs : std::max(1u, std::thread::hardware_concurrency());
+    unsigned int running = 0;
+    std::cout << "Listening on " << socket_path << std::endl;
+
+    while(!stopping) {
+        //Wakes up at least once a second, so an idle server reaps its jobs and
+        //has reloaded a changed configuration before the next job comes in
+        pollfd waiting{server, POLLIN, 0};
+        int ready = poll(&waiting, 1, 1000);
+
+        while(running > 0 && waitpid(-1, nullptr, WNOHANG) > 0) {
+            running--;
+        }
+        if(warm_state_stale(warm)) {
+            if(reload_warm_state(warm, table_args, defaults)) {
+                std::cout << "Configuration reloaded: " << warm.programs->images.size() << " program(s)" << std::endl;
+            } else {
+                std::cerr << "Warning: the configuration does not load, jobs keep the previous one" << std::endl;
+            }
+        }
+        if(ready <= 0) {
+            continue;
+        }
+
+        int client = accept(server, nullptr, nullptr);
+        if(client < 0) {
+            continue;
+        }
+        while(running >= max_jobs && waitpid(-1, nullptr, 0) > 0) {
+            running--;
+        }
+
+        //The child must not write what the server has buffered a second time
+        std::cout.flush();
+        std::fflush(nullptr);
+        pid_t child = fork();
+        if(child == 0) {
+            close(server);
+            serve_job(client, server_args, defaults, warm);
+        }
+        close(client);
+        if(child < 0) {
+            std::cerr << "Error: Unable to start a job" << std::endl;
+            continue;
+        }
+        running++;
+    }
+
+    close(server);
+    unlink(socket_path.c_str());
+    while(waitpid(-1, nullptr, 0) > 0) {
+    }
+    return 0;
+}
+
+#else
+
+int main() {
+    std::cerr << "Error: the server needs Unix domain sockets" << std::endl;
+    return 1;
+}
+
+#endif
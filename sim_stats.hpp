@@ -0,0 +1,178 @@
+#ifndef SIM_STATS_HPP_
+#define SIM_STATS_HPP_
+
+// Opt-in instrumentation of the hot paths: event counters per activity,
+// allocation and output counters and steady_clock timers per phase, written to
+// a JSON file at exit (--stats-file=<file>).
+//
+// Only built with -DSIM_STATS. Otherwise every SIM_STAT_* macro expands to
+// nothing and write_stats does nothing, so a normal build pays for none of it.
+//
+// Each thread counts into its own sim_stats_t, merged into the totals when the
+// thread ends, so batch workers never contend on the counters.
+
+#include <string>
+
+#ifdef SIM_STATS
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+enum class stat_counter_t : uint8_t {
+    ALLOCATIONS,
+    ALLOCATION_FAILURES,
+    FREES,
+    PROCESSES,          //!< process contexts created (init, forked children)
+    PCB_TABLES,         //!< PCB tables written to system_status.txt
+    PCB_ROWS,           //!< PCB table rows formatted
+    OUTPUT_BYTES,       //!< bytes written to the output files
+    OUTPUT_WRITES,      //!< writes to the output files
+    MEMO_RECORDINGS,    //!< EXEC'd program runs recorded for replay (segment_memo.hpp)
+    MEMO_REPLAYS,       //!< EXEC'd program runs replayed instead of simulated
+    COUNT
+};
+
+const char* const stat_counter_names[] = {
+    "allocations", "allocation_failures", "frees", "processes",
+    "pcb_tables", "pcb_rows", "output_bytes", "output_writes",
+    "memo_recordings", "memo_replays"
+};
+
+// Timers are inclusive: "simulate" contains the time of the phases it calls
+enum class stat_timer_t : uint8_t {
+    PARSE,              //!< compiling traces and programs
+    SIMULATE,           //!< simulator_t::run
+    INTR_BOILERPLATE,
+    PRINT_PCB,
+    OUTPUT_WRITE,       //!< writing buffers out to the output files
+    COUNT
+};
+
+const char* const stat_timer_names[] = {
+    "parse", "simulate", "intr_boilerplate", "print_pcb", "output_write"
+};
+
+// Same order as activity_t (trace_ir.hpp)
+const char* const stat_activity_names[] = {
+    "CPU", "SYSCALL", "END_IO", "FORK", "EXEC", "IF_CHILD", "IF_PARENT", "ENDIF", "UNKNOWN"
+};
+
+const size_t STAT_ACTIVITIES = sizeof(stat_activity_names) / sizeof(stat_activity_names[0]);
+
+struct sim_stats_t {
+    std::array<uint64_t, STAT_ACTIVITIES>                       activities{};
+    std::array<uint64_t, static_cast<size_t>(stat_counter_t::COUNT)> counters{};
+    std::array<uint64_t, static_cast<size_t>(stat_timer_t::COUNT)>   timer_ns{};
+    std::array<uint64_t, static_cast<size_t>(stat_timer_t::COUNT)>   timer_calls{};
+    uint64_t                                                    max_depth = 0;  //!< most processes alive at once (nesting depth with the legacy scheduler)
+
+    void merge(const sim_stats_t& other) {
+        for(size_t i = 0; i < activities.size(); i++) activities[i] += other.activities[i];
+        for(size_t i = 0; i < counters.size(); i++) counters[i] += other.counters[i];
+        for(size_t i = 0; i < timer_ns.size(); i++) timer_ns[i] += other.timer_ns[i];
+        for(size_t i = 0; i < timer_calls.size(); i++) timer_calls[i] += other.timer_calls[i];
+        max_depth = std::max(max_depth, other.max_depth);
+    }
+};
+
+// Totals of the threads that have ended
+struct sim_stats_totals_t {
+    std::mutex      lock;
+    sim_stats_t     stats;
+};
+
+sim_stats_totals_t& stats_totals() {
+    static sim_stats_totals_t totals;
+    return totals;
+}
+
+// The calling thread's counters, merged into the totals when the thread ends
+struct thread_stats_t {
+    sim_stats_t     stats;
+
+    ~thread_stats_t() {
+        sim_stats_totals_t& totals = stats_totals();
+        std::lock_guard<std::mutex> guard(totals.lock);
+        totals.stats.merge(stats);
+    }
+};
+
+sim_stats_t& local_stats() {
+    thread_local thread_stats_t local;
+    return local.stats;
+}
+
+// Adds the time from its construction to its destruction to a timer
+class stat_scope_t {
+public:
+    explicit stat_scope_t(stat_timer_t _timer):
+        timer(static_cast<size_t>(_timer)), start(std::chrono::steady_clock::now()) {}
+
+    ~stat_scope_t() {
+        sim_stats_t& stats = local_stats();
+        stats.timer_ns[timer] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        stats.timer_calls[timer]++;
+    }
+
+private:
+    size_t                                  timer;
+    std::chrono::steady_clock::time_point   start;
+};
+
+#define SIM_STAT_COUNT(counter, n)  (local_stats().counters[static_cast<size_t>(stat_counter_t::counter)] += (n))
+#define SIM_STAT_ACTIVITY(activity) (local_stats().activities[static_cast<size_t>(activity)]++)
+#define SIM_STAT_DEPTH(depth)       (local_stats().max_depth = std::max<uint64_t>(local_stats().max_depth, (depth)))
+#define SIM_STAT_TIMER(timer)       stat_scope_t sim_stat_scope_##timer(stat_timer_t::timer)
+
+//Writes the counters and timers of every thread so far (the worker threads
+//must have ended) to a JSON file
+void write_stats(const std::string& filename) {
+    sim_stats_t stats;
+    {
+        sim_stats_totals_t& totals = stats_totals();
+        std::lock_guard<std::mutex> guard(totals.lock);
+        stats = totals.stats;
+    }
+    stats.merge(local_stats());
+
+    std::ofstream output_file(filename);
+    if(!output_file.is_open()) {
+        std::cerr << "Error opening file " << filename << "!" << std::endl;
+        return;
+    }
+
+    output_file << "{\n  \"activities\": {";
+    for(size_t i = 0; i < stats.activities.size(); i++) {
+        output_file << (i ? ", " : "") << "\"" << stat_activity_names[i] << "\": " << stats.activities[i];
+    }
+    output_file << "},\n  \"counters\": {";
+    for(size_t i = 0; i < stats.counters.size(); i++) {
+        output_file << (i ? ", " : "") << "\"" << stat_counter_names[i] << "\": " << stats.counters[i];
+    }
+    output_file << "},\n  \"max_depth\": " << stats.max_depth << ",\n  \"timers\": {";
+    for(size_t i = 0; i < stats.timer_ns.size(); i++) {
+        output_file << (i ? "," : "") << "\n    \"" << stat_timer_names[i] << "\": {\"calls\": " << stats.timer_calls[i]
+                    << ", \"ms\": " << stats.timer_ns[i] / 1e6 << "}";
+    }
+    output_file << "\n  }\n}\n";
+
+    std::cout << "Stats written to " << filename << std::endl;
+}
+
+#else
+
+#define SIM_STAT_COUNT(counter, n)  ((void)0)
+#define SIM_STAT_ACTIVITY(activity) ((void)0)
+#define SIM_STAT_DEPTH(depth)       ((void)0)
+#define SIM_STAT_TIMER(timer)       ((void)0)
+
+void write_stats(const std::string&) {}
+
+#endif
+
+#endif
@@ -0,0 +1,1344 @@
+#ifndef SIMULATOR_HPP_
+#define SIMULATOR_HPP_
+
+#include "interrupts_101299776_101187793.hpp"
+#include "trace_ir.hpp"
+#include "program_cache.hpp"
+#include "output_sink.hpp"
+#include "scheduler.hpp"
+#include "event_format.hpp"
+#include "status_snapshot.hpp"
+#include "event_queue.hpp"
+#include "checkpoint.hpp"
+#include "segment_memo.hpp"
+#include "task_pool.hpp"
+#include "time_profile.hpp"
+#include "time_index.hpp"
+
+// Everything needed to resume a process: its PCB, the trace it runs and where
+// it is in that trace
+struct process_context_t {
+    PCB                                     pcb;
+    const trace_view_t*                     view;
+    size_t                                  ip;         //!< position of the next instruction in view
+    int                                     remaining;  //!< what is left of a preempted CPU burst
+    long long                               created;    //!< creation time, for the turnaround
+    size_t                                  table_mark; //!< legacy: process table journal position to roll back to when the process ends
+    std::shared_ptr<const program_image_t>  image;      //!< keeps an exec'd program alive while it runs
+    std::shared_ptr<const trace_view_t>     view_owner; //!< keeps the view of a child of a streamed trace alive while it (or its children) runs
+    size_t                                  core;       //!< core whose run queue the process goes back to
+    int                                     ready_time; //!< when the process last became ready
+    int                                     io_done = -1;   //!< --async-io: device whose completion no END_IO has met yet (-1: none)
+    size_t                                  frame = time_profile_t::NO_FRAME;   //!< --time-profile: the stack the process charges its time to
+
+    process_context_t(PCB _pcb, const trace_view_t* _view, long long _created, size_t _table_mark, size_t _core = 0):
+        pcb(std::move(_pcb)), view(_view), ip(0), remaining(0), created(_created), table_mark(_table_mark),
+        core(_core), ready_time(_created) {}
+};
+
+const size_t NO_PROCESS = static_cast<size_t>(-1);
+const size_t NO_CORE = static_cast<size_t>(-1);
+
+// One CPU of a --cores run, with its own run queue and clock. The core taking
+// the current step keeps its scheduler, running process and clock in the
+// simulator's members instead (see simulator_t::activate_core), so the
+// single-core loop runs unchanged on whichever core is active.
+struct core_t {
+    std::unique_ptr<scheduler_t>    scheduler;
+    size_t                          running = NO_PROCESS;
+    size_t                          previous = NO_PROCESS;
+    int                             clock = 0;
+    long long                       busy = 0;       //!< time spent running processes
+    long long                       migration = 0;  //!< time spent taking in stolen processes
+    size_t                          steals = 0;
+    std::string                     label;          //!< "[core <n>] ", written before each of its events
+};
+
+// One simulation run. The simulator owns everything a run changes: the
+// simulated memory, the PID counter, the scheduler and the CPU state, so
+// several simulators can run side by side in one process. The configuration
+// tables and the program cache are shared between simulators and only read.
+class simulator_t {
+public:
+    simulator_t(const sim_config_t& _config, const sim_options_t& options, program_cache_t& _program_cache):
+        memory(_config.partition_sizes, options.memory_policy, options.buddy_size, options.buddy_min),
+        scheduler(make_scheduler(options.scheduler, options.quantum)),
+        config(_config),
+#ifndef SIM_FIXED_TIMING
+        timing(_config.timing),
+#endif
+        program_cache(_program_cache), events(_config.vectors),
+        snapshots(options.snapshots, options.snapshot_every), async_io(options.async_io),
+        checkpoint_file(options.checkpoint_file), checkpoint_at(options.checkpoint_at), checkpoint_only(options.checkpoint_only),
+        migration_cost(options.migration_cost), memo_enabled(options.memo), fork_grain(options.fork_grain) {
+        //Core 0 starts active: its state is in the members, its slot is empty
+        if(options.cores > 1) {
+            cores.resize(options.cores);
+            for(size_t c = 0; c < cores.size(); c++) {
+                if(c > 0) {
+                    cores[c].scheduler = make_scheduler(options.scheduler, options.quantum);
+                }
+                cores[c].label = "[core " + std::to_string(c) + "] ";
+            }
+            events.prefix = cores[0].label;
+        }
+        if(options.fork_workers > 0 && scheduler->legacy()) {
+            fork_pool = std::make_shared<task_pool_t>(options.fork_workers);
+        }
+        if(!options.time_profile_file.empty() || !options.pid_summary_file.empty()) {
+            profile = std::make_unique<time_profile_t>();
+        }
+    }
+
+    //Simulates a whole trace, starting from the init process at time 0
+    //returns the simulation time when the trace is done
+    int run(const trace_view_t& trace, output_sink_t& execution, output_sink_t& system_status) {
+        root = &trace;
+        if(index) {
+            index->attach(&execution, &system_status);
+            index->begin(0, time_index_t::NO_PID);
+        }
+
+        //Make initial PCB (notice how partition is not assigned yet)
+        PCB current(0, -1, "init", 1, -1);
+        auto priority = config.priorities.find("init");
+        if(priority != config.priorities.end()) {
+            current.priority = priority->second;
+        }
+
+        //Update memory (partition is assigned here)
+        if(!allocate_memory(&current)) {
+            std::cerr << "ERROR! Memory allocation failed!" << std::endl;
+        } else if(index) {
+            index->allocate(current, current_time);
+        }
+
+        SIM_STAT_TIMER(SIMULATE);
+        return simulate_trace(trace, 0, current, execution, system_status);
+    }
+
+    //Restores the state saved in a checkpoint of a run of `trace`. The output
+    //files are to be opened with resume_offsets, then resume() continues the run.
+    //returns false if the file is not a checkpoint of this trace and configuration
+    bool load_checkpoint(const std::string& filename, const trace_view_t& trace);
+
+    //Continues the run restored by load_checkpoint
+    //returns the simulation time when the trace is done
+    int resume(output_sink_t& execution, output_sink_t& system_status) {
+        if(index) {
+            index->attach(&execution, &system_status);
+            restore_index();
+        }
+        SIM_STAT_TIMER(SIMULATE);
+        return simulate(execution, system_status);
+    }
+
+    //Prints the scheduler statistics of the run, and its memory statistics if `memory_stats`
+    void print_stats(bool memory_stats) const;
+
+    partition_table_t               memory;
+    std::unique_ptr<scheduler_t>    scheduler;
+    size_t                          instructions_executed = 0;  //!< trace lines simulated, across every process
+    size_t                          resume_offsets[2] = {0, 0}; //!< execution.txt and system_status.txt bytes written before a restored checkpoint
+    std::unique_ptr<time_profile_t> profile;                    //!< where the simulated time went, with --time-profile or --pid-summary
+    std::unique_ptr<time_index_t>   index;                      //!< --time-index: every state change, set by the caller before run()
+
+private:
+    //Allocates a program to memory (if there is space), using the placement policy of the partition table
+    //returns true if the allocation was sucessful, false if not.
+    //A renderer has no memory of its own: it takes the partitions the dry run
+    //of its subtree handed out, in the same order.
+    bool allocate_memory(PCB* current) {
+        int partition_number = renderer ? replayed_allocations.at(next_allocation++)
+                                        : memory.allocate(current->size, current->program_name());
+        if(dry_run != NO_PROCESS) {
+            allocations.push_back(partition_number);
+        }
+        if(partition_number < 0) {
+            SIM_STAT_COUNT(ALLOCATION_FAILURES, 1);
+            return false;
+        }
+        SIM_STAT_COUNT(ALLOCATIONS, 1);
+        current->partition_number = partition_number;
+        return true;
+    }
+
+    //frees the memory given PCB.
+    void free_memory(PCB* process) {
+        SIM_STAT_COUNT(FREES, 1);
+        if(!renderer) {
+            memory.release(process->partition_number);
+        }
+        process->partition_number = -1;
+    }
+
+    PCB create_child_pcb(const PCB& parent);
+
+    size_t add_process(PCB pcb, const trace_view_t* view);
+
+    void make_ready(size_t slot) {
+        make_ready(slot, current_time);
+    }
+
+    void make_ready(size_t slot, int time);
+
+    scheduler_t& queue_of(size_t c) const {
+        return c == core ? *scheduler : *cores[c].scheduler;
+    }
+
+    void park_core();
+    void activate_core(size_t c);
+    void steal(size_t thief, size_t victim, output_sink_t& execution);
+    bool select_core(output_sink_t& execution);
+
+    int simulate_trace(const trace_view_t& trace, int time, PCB init, output_sink_t& execution, output_sink_t& system_status);
+    int simulate(output_sink_t& execution, output_sink_t& system_status);
+
+    void save_checkpoint(output_sink_t& execution, output_sink_t& system_status);
+    void restore_index();
+    void save_view(checkpoint_writer_t& out, const trace_view_t* view);
+    const trace_view_t* load_view(checkpoint_reader_t& in);
+
+    const sim_config_t&     config;
+#ifdef SIM_FIXED_TIMING
+    static constexpr timing_model_t timing = BUILT_IN_TIMING;   //!< folded into the code of this build
+#else
+    const timing_model_t    timing;         //!< the interrupt and EXEC step costs (--timing)
+#endif
+    program_cache_t&        program_cache;
+    event_formatter_t       events;         //!< execution.txt formatting, with the vector table lines cached
+    snapshot_writer_t       snapshots;      //!< system_status.txt snapshots, following --snapshots
+    process_table_t         table;          //!< PCB table: waiting processes (legacy) or every live process
+    bool                    async_io;       //!< SYSCALLs block the caller until a device completion event
+    event_queue_t           pending;        //!< device completions not delivered yet
+    const trace_view_t*     root = nullptr; //!< the trace the run started from
+
+    //Process contexts, indexed by the numbers handed to the scheduler. Slots of
+    //finished processes are reused.
+    std::vector<process_context_t> processes;
+    std::vector<size_t>     free_slots;
+    size_t                  running = NO_PROCESS;
+    size_t                  previous = NO_PROCESS;      //!< last process dispatched
+    int                     current_time = 0;
+
+    std::string             checkpoint_file;
+    long long               checkpoint_at;              //!< -1 once the checkpoint is saved (or if none was asked for)
+    bool                    checkpoint_only;
+
+    //--cores: every core, the active one's state being in the members above
+    std::vector<core_t>     cores;                      //!< empty on a single core
+    size_t                  core = 0;                   //!< the active core, NO_CORE between steps
+    int                     step_start = 0;             //!< clock of the active core when it was activated
+    int                     migration_cost;
+
+    //--memo: runs of leaf programs are replayed when nothing can interleave
+    //with them (no quantum, no background I/O, one core, no checkpoint to take)
+    //and nothing to charge their time to (no --time-profile)
+    bool                    memo_enabled;
+    segment_memo_t          memo;
+
+    bool memoizable() const {
+        return memo_enabled && scheduler->quantum == 0 && !async_io && cores.empty() && checkpoint_at < 0 && !profile;
+    }
+
+    //--time-profile: charges `ms` of `activity` to the process of `context`
+    void charge(const process_context_t& context, profile_activity_t activity, long long ms, int device = -1) {
+        if(profile) {
+            profile->charge(context.frame, activity, ms, device);
+        }
+    }
+
+    //--fork-workers: the output of large forked subtrees is rendered by other
+    //threads (legacy scheduler only)
+    simulator_t(const simulator_t& main, size_t slot);
+    void render_subtree(size_t slot, output_sink_t& execution, output_sink_t& system_status);
+
+    std::shared_ptr<task_pool_t> fork_pool;             //!< null unless --fork-workers
+    size_t                  fork_grain;                 //!< smallest child block (in lines) handed to a worker
+    size_t                  dry_run = NO_PROCESS;       //!< process whose subtree is run without output, a worker renders it
+    std::vector<int>        allocations;                //!< partitions handed out during the dry run, for its renderer
+    std::shared_ptr<std::promise<std::vector<int>>> allocations_done;  //!< gets `allocations` once the dry run is over
+    bool                    renderer = false;           //!< this simulator renders a subtree for another one
+    std::vector<int>        replayed_allocations;       //!< renderer: the partitions of the dry run
+    size_t                  next_allocation = 0;
+
+    // Process management
+    unsigned int            next_pid = 1;
+
+    // State tracking variables
+    bool                    in_user_mode = true;            // user or kernel mode
+    bool                    processing_interrupt = false;   // interrupt processing flag
+    int                     device_number = -1;             // current device
+};
+
+//Puts a process in the run queue of its core. A core that had nothing to do
+//cannot run it before it became ready, so that core's clock moves up to `time`.
+void simulator_t::make_ready(size_t slot, int time) {
+    process_context_t& context = processes[slot];
+    context.ready_time = time;
+    if(context.core == core) {
+        scheduler->add(slot, context.pcb.priority, context.created);
+        return;
+    }
+    core_t& target = cores[context.core];
+    if(target.running == NO_PROCESS && target.scheduler->empty()) {
+        target.clock = std::max(target.clock, time);
+    }
+    target.scheduler->add(slot, context.pcb.priority, context.created);
+}
+
+//Moves the active core's state back into its slot, counting the time it just spent as busy
+void simulator_t::park_core() {
+    if(core == NO_CORE) {
+        return;
+    }
+    core_t& active = cores[core];
+    active.busy += current_time - step_start;
+    std::swap(active.scheduler, scheduler);
+    active.running = running;
+    active.previous = previous;
+    active.clock = current_time;
+    core = NO_CORE;
+}
+
+//Makes a parked core the active one
+void simulator_t::activate_core(size_t c) {
+    core_t& next = cores[c];
+    std::swap(next.scheduler, scheduler);
+    running = next.running;
+    previous = next.previous;
+    current_time = next.clock;
+    step_start = current_time;
+    events.prefix = next.label;
+    core = c;
+}
+
+//An idle core takes the process another core would run next. It cannot start
+//before the process became ready, and moving the process in costs --migration-cost.
+void simulator_t::steal(size_t thief, size_t victim, output_sink_t& execution) {
+    size_t slot = cores[victim].scheduler->pick();
+    process_context_t& context = processes[slot];
+    core_t& idle = cores[thief];
+
+    idle.clock = std::max(idle.clock, context.ready_time);
+    log_event(execution, idle.clock, migration_cost, idle.label, "steals PID ", context.pcb.PID, " from core ", victim, "\n\n");
+    idle.clock += migration_cost;
+    idle.migration += migration_cost;
+    charge(context, profile_activity_t::MIGRATION, migration_cost);
+    idle.steals++;
+
+    context.core = thief;
+    context.ready_time = idle.clock;
+    idle.scheduler->add(slot, context.pcb.priority, context.created);
+}
+
+//--cores: picks the core that takes the next step, the one with the earliest
+//clock among those with something to run. Idle cores behind it first steal
+//from the longest run queue they can start from sooner than its own core
+//would or, with nothing worth stealing, wait for the next thing to happen;
+//device completions are delivered as their time comes.
+//Each core writes its events in time order; cores take turns step by step,
+//so a long step of one core may be followed by earlier events of another.
+//returns false when no core has anything left to run
+bool simulator_t::select_core(output_sink_t& execution) {
+    park_core();
+
+    while(true) {
+        size_t earliest = NO_CORE;
+        size_t idle = NO_CORE;
+        for(size_t c = 0; c < cores.size(); c++) {
+            const core_t& candidate = cores[c];
+            if(candidate.running == NO_PROCESS && candidate.scheduler->empty()) {
+                if(idle == NO_CORE || candidate.clock < cores[idle].clock) {
+                    idle = c;
+                }
+            } else if(earliest == NO_CORE || candidate.clock < cores[earliest].clock) {
+                earliest = c;
+            }
+        }
+
+        size_t busiest = NO_CORE;
+        if(idle != NO_CORE) {
+            for(size_t c = 0; c < cores.size(); c++) {
+                const core_t& victim = cores[c];
+                if(victim.scheduler->empty() || victim.scheduler->size() <= (busiest == NO_CORE ? 0 : cores[busiest].scheduler->size())) {
+                    continue;
+                }
+                //Worth it only if the thief starts before the victim's core gets to it
+                int start = std::max(cores[idle].clock, processes[victim.scheduler->peek()].ready_time);
+                if(start + migration_cost < victim.clock) {
+                    busiest = c;
+                }
+            }
+        }
+
+        //Completions due before anything else can happen
+        long long next = earliest == NO_CORE ? LLONG_MAX : cores[earliest].clock;
+        if(idle != NO_CORE) {
+            next = std::min<long long>(next, cores[idle].clock);
+        }
+        if(!pending.empty() && pending.next().time <= next) {
+            const sim_event_t& event = pending.next();
+            size_t target = processes[event.context].core;
+            log_event(execution, event.time, 0, cores[target].label, "device ", event.device, " done, PID ",
+                      processes[event.context].pcb.PID, " ready\n\n");
+            make_ready(event.context, event.time);
+            pending.pop();
+            continue;
+        }
+
+        if(idle != NO_CORE && (earliest == NO_CORE || cores[idle].clock < cores[earliest].clock)) {
+            if(busiest != NO_CORE) {
+                steal(idle, busiest, execution);
+                continue;
+            }
+            //Nothing to steal: the core waits for the others or for a device
+            long long wake = earliest == NO_CORE ? LLONG_MAX : cores[earliest].clock;
+            if(!pending.empty()) {
+                wake = std::min<long long>(wake, pending.next().time);
+            }
+            if(wake == LLONG_MAX) {
+                return false;
+            }
+            cores[idle].clock = wake;
+            continue;
+        }
+
+        if(earliest == NO_CORE) {
+            return false;
+        }
+        activate_core(earliest);
+        return true;
+    }
+}
+
+void simulator_t::print_stats(bool memory_stats) const {
+    if(memory_stats) {
+        print_memory_stats(memory);
+    }
+    if(cores.empty()) {
+        print_schedule_stats(*scheduler);
+        return;
+    }
+
+    schedule_stats_t total;
+    for(size_t c = 0; c < cores.size(); c++) {
+        const schedule_stats_t& stats = queue_of(c).stats;
+        total.dispatches += stats.dispatches;
+        total.preemptions += stats.preemptions;
+        total.finished += stats.finished;
+        total.total_turnaround += stats.total_turnaround;
+        total.io_requests += stats.io_requests;
+        total.idle_time += current_time - cores[c].busy - cores[c].migration;
+    }
+    print_schedule_stats(*scheduler, total);
+
+    for(size_t c = 0; c < cores.size(); c++) {
+        const core_t& stats = cores[c];
+        std::cout << "Core " << c << ": busy " << stats.busy << " ms ("
+                  << (current_time > 0 ? stats.busy * 100 / current_time : 0) << "%), "
+                  << stats.steals << " steal(s), " << stats.migration << " ms migrating, idle "
+                  << current_time - stats.busy - stats.migration << " ms" << std::endl;
+    }
+}
+
+//A renderer starts from the state right after `main` forked the process in
+//`slot`, with only that process to run: it ends when the process does, its
+//children having run on top of it (legacy scheduler). The subtree only adds
+//PIDs from the child's on, and gets its partitions from the dry run, so the
+//renderer copies neither the whole process table nor the memory. It prints no
+//errors and counts no program cache lookups, `main` does that for the same
+//subtree.
+simulator_t::simulator_t(const simulator_t& main, size_t slot):
+    scheduler(make_scheduler("legacy", 0)),
+    config(main.config),
+#ifndef SIM_FIXED_TIMING
+    timing(main.timing),
+#endif
+    program_cache(main.program_cache), events(main.events),
+    snapshots(main.snapshots), table(main.table.copy_live(main.processes[slot].pcb.PID)), async_io(false), root(main.root),
+    current_time(main.current_time), checkpoint_at(-1), checkpoint_only(false), migration_cost(0),
+    memo_enabled(main.memo_enabled), fork_grain(main.fork_grain), renderer(true), next_pid(main.next_pid) {
+    processes.push_back(main.processes[slot]);
+    processes[0].table_mark = 0;
+    make_ready(0);
+}
+
+//--fork-workers: a worker renders the output of the subtree of the child just
+//forked into `slot`, from a copy of the simulator, while this simulator runs the
+//same subtree dry (without formatting any output) to get on with the parent.
+//The worker's output goes into the sinks where the subtree's output belongs,
+//so the files are the same as if the subtree was rendered here.
+void simulator_t::render_subtree(size_t slot, output_sink_t& execution, output_sink_t& system_status) {
+    std::shared_ptr<simulator_t> worker(new simulator_t(*this, slot));
+    auto execution_part = std::make_shared<std::promise<output_chunks_t>>();
+    auto status_part = std::make_shared<std::promise<output_chunks_t>>();
+    execution.splice(execution_part->get_future());
+    system_status.splice(status_part->get_future());
+    allocations_done = std::make_shared<std::promise<std::vector<int>>>();
+    auto dry_allocations = allocations_done->get_future().share();
+
+    fork_pool->submit([worker, execution_part, status_part, dry_allocations]() {
+        output_sink_t execution(64 * 1024);
+        output_sink_t system_status(64 * 1024);
+        try {
+            worker->replayed_allocations = dry_allocations.get();
+            worker->simulate(execution, system_status);
+        } catch(...) {
+            execution_part->set_exception(std::current_exception());
+            status_part->set_exception(std::current_exception());
+            return;
+        }
+        execution_part->set_value(execution.take());
+        status_part->set_value(system_status.take());
+    });
+
+    execution.discard = true;
+    system_status.discard = true;
+    dry_run = slot;
+}
+
+//The child is a copy of its parent with a new PID (the program is an interned
+//id, so this copies no string)
+PCB simulator_t::create_child_pcb(const PCB& parent) {
+    PCB child = parent;
+    child.PID = next_pid++;
+    child.PPID = parent.PID;
+    return child;
+}
+
+//Adds a process context, reusing the slot of a finished process if there is one
+//returns the slot
+size_t simulator_t::add_process(PCB pcb, const trace_view_t* view) {
+    size_t slot;
+    if(free_slots.empty()) {
+        slot = processes.size();
+        processes.emplace_back(std::move(pcb), view, current_time, table.mark(), core);
+    } else {
+        slot = free_slots.back();
+        free_slots.pop_back();
+        processes[slot] = process_context_t(std::move(pcb), view, current_time, table.mark(), core);
+    }
+    SIM_STAT_COUNT(PROCESSES, 1);
+    SIM_STAT_DEPTH(processes.size() - free_slots.size());
+    if(index) {
+        index->process(processes[slot].pcb, current_time);
+    }
+    return slot;
+}
+
+//Simulates the trace and streams its events into the execution and system status sinks.
+//returns the simulation time when the trace is done
+int simulator_t::simulate_trace(const trace_view_t& trace, int time, PCB init, output_sink_t& execution, output_sink_t& system_status) {
+    current_time = time;
+
+    //With the legacy scheduler every process sees its own version of the PCB
+    //table: the child runs to completion on top of its parent, and its changes
+    //to the table are rolled back when it ends. Any other scheduler sees one
+    //table of all live processes, in PID order.
+    table = process_table_t();
+    table.track(snapshots.diff());
+    table.push_back(init);
+    table.journaling = scheduler->legacy();
+
+    processes.clear();
+    free_slots.clear();
+    size_t first = add_process(std::move(init), &trace);
+    if(profile) {
+        processes[first].frame = profile->push(time_profile_t::NO_FRAME, processes[first].pcb);
+    }
+    make_ready(first);
+
+    running = NO_PROCESS;
+    previous = NO_PROCESS;
+
+    return simulate(execution, system_status);
+}
+
+//Runs the processes until every one of them is done.
+//Every process (FORK children, EXEC'd programs) is a context driven by the same
+//loop; the scheduler decides which ready context runs whenever the running one
+//calls it, ends or, with a quantum, is preempted. The configuration tables are
+//shared by reference by every context.
+//returns the simulation time when the trace is done
+int simulator_t::simulate(output_sink_t& execution, output_sink_t& system_status) {
+
+    const std::vector<int>& delays = config.delays;
+    const std::vector<external_file>& external_files = config.external_files;
+
+    const bool legacy = scheduler->legacy();
+
+    //The status output shows the running process and, as waiting, the rest of
+    //the table (in scheduled mode the table holds the running process too)
+    auto write_snapshot = [&](std::string_view trace_line, const PCB& running_pcb) {
+        snapshots.write(system_status, current_time, trace_line, running_pcb, table,
+                        legacy ? process_table_t::NO_PID : running_pcb.PID);
+    };
+
+    //Lets the scheduler pick the next process, logging every switch to another process
+    auto dispatch = [&]() {
+        running = scheduler->pick();
+        if(index) {
+            index->running(processes[running].pcb.PID, current_time);
+        }
+        if(memo.recording() && !memo.recording_by(running)) {
+            memo.abort(execution);
+        }
+        if(!legacy) {
+            scheduler->stats.dispatches++;
+            if(running != previous) {
+                log_event(execution, current_time, 0, events.prefix, "dispatching PID ", processes[running].pcb.PID, " (", scheduler->name(), ")\n\n");
+            }
+        }
+        previous = running;
+    };
+
+    //Makes the processes whose device is done ready again
+    auto deliver_events = [&]() {
+        while(!pending.empty() && pending.next().time <= current_time) {
+            const sim_event_t& event = pending.next();
+            log_event(execution, event.time, 0, events.prefix, "device ", event.device, " done, PID ",
+                      processes[event.context].pcb.PID, " ready\n\n");
+            processes[event.context].io_done = event.device;
+            make_ready(event.context);
+            pending.pop();
+        }
+    };
+
+    while(true) {
+        //On several cores each step is taken by the core that is furthest behind
+        if(!cores.empty() && !select_core(execution)) {
+            break;
+        }
+
+        //Between two instructions the whole state is in the simulator, which
+        //is where a checkpoint can be taken
+        if(checkpoint_at >= 0 && current_time >= checkpoint_at) {
+            save_checkpoint(execution, system_status);
+            checkpoint_at = -1;
+            if(checkpoint_only) {
+                break;
+            }
+        }
+
+        deliver_events();
+        if(running == NO_PROCESS) {
+            if(scheduler->empty()) {
+                if(pending.empty()) {
+                    if(index) {
+                        index->running(time_index_t::NO_PID, current_time);
+                    }
+                    break;
+                }
+                //Every process is waiting for a device: the CPU idles until the next completion
+                long long idle = pending.next().time - current_time;
+                log_event(execution, current_time, idle, events.prefix, "CPU idle\n\n");
+                scheduler->stats.idle_time += idle;
+                if(profile) {
+                    profile->charge(time_profile_t::NO_FRAME, profile_activity_t::IDLE, idle);
+                }
+                if(index) {
+                    index->running(time_index_t::NO_PID, current_time);
+                }
+                current_time = pending.next().time;
+                continue;
+            }
+            dispatch();
+        }
+
+        process_context_t& context = processes[running];
+        const trace_view_t& trace_file = *context.view;
+
+        if(context.remaining == 0 && !trace_file.reached(context.ip)) {
+            //Done with this trace, the process ends
+            if(running == dry_run) {
+                //The worker has the subtree's output, ours goes on from here
+                execution.discard = false;
+                system_status.discard = false;
+                dry_run = NO_PROCESS;
+                allocations_done->set_value(std::move(allocations));
+                allocations.clear();
+                allocations_done.reset();
+            }
+            if(memo.recording_by(running)) {
+                memo.end(execution, current_time);
+            }
+            if(!legacy) {
+                log_event(execution, current_time, 0, events.prefix, "PID ", context.pcb.PID, " terminated\n\n");
+                scheduler->stats.finished++;
+                scheduler->stats.total_turnaround += current_time - context.created;
+                table.remove(context.pcb.PID);
+                if(context.pcb.partition_number != -1) {
+                    if(index) {
+                        index->release(context.pcb.partition_number, current_time);
+                    }
+                    free_memory(&context.pcb);
+                }
+            } else {
+                table.rollback(context.table_mark);
+            }
+            if(index) {
+                index->exit(context.pcb.PID, current_time);
+            }
+            context.image.reset();
+            context.view_owner.reset();
+            free_slots.push_back(running);
+            running = NO_PROCESS;
+            continue;
+        }
+
+        if(context.remaining > 0) {
+            //Resume a CPU burst that was preempted
+            int slice = context.remaining;
+            if(scheduler->quantum > 0 && slice > scheduler->quantum && !scheduler->empty()) {
+                slice = scheduler->quantum;
+            }
+            log_event(execution, current_time, slice, events.prefix, "CPU Burst\n\n");
+            current_time += slice;
+            charge(context, profile_activity_t::CPU, slice);
+            context.remaining -= slice;
+            if(context.remaining > 0) {
+                scheduler->stats.preemptions++;
+                make_ready(running);
+                running = NO_PROCESS;
+            }
+            continue;
+        }
+
+        //A leaf program starting its run is replayed if it ran before, and
+        //recorded otherwise
+        if(context.ip == 0 && context.image && trace_file.source == &context.image->trace && memoizable()
+           && memo.leaf(context.pcb.program, trace_file)) {
+            if(const replay_segment_t* segment = memo.find(context.pcb.program)) {
+                current_time = segment_memo_t::replay(execution, *segment, current_time);
+                for(size_t k = 0; k < trace_file.size(); k++) {
+                    SIM_STAT_ACTIVITY(trace_file[k].activity);
+                }
+                instructions_executed += trace_file.size();
+                context.ip = trace_file.size();
+                continue;
+            }
+            memo.begin(execution, context.pcb.program, running, current_time);
+        }
+
+        const compiled_trace_t& source = *trace_file.source;
+        PCB& current = context.pcb;
+
+        size_t i = context.ip++;
+        instructions_executed++;
+        //A copy: resolving a FORK of a streamed trace reads more lines, which may move them
+        const instruction_t instruction = trace_file[i];
+        SIM_STAT_ACTIVITY(instruction.activity);
+        const int duration_intr = instruction.operand;
+
+        switch(instruction.activity) {
+        case activity_t::CPU:
+            if(scheduler->quantum > 0 && duration_intr > scheduler->quantum && !scheduler->empty()) {
+                //Only the first time slice now, the rest when the process is dispatched again
+                log_event(execution, current_time, scheduler->quantum, events.prefix, "CPU Burst\n\n");
+                current_time += scheduler->quantum;
+                charge(context, profile_activity_t::CPU, scheduler->quantum);
+                context.remaining = duration_intr - scheduler->quantum;
+                scheduler->stats.preemptions++;
+                make_ready(running);
+                running = NO_PROCESS;
+                break;
+            }
+            log_event(execution, current_time, duration_intr, events.prefix, "CPU Burst\n\n");
+            current_time += duration_intr;
+            charge(context, profile_activity_t::CPU, duration_intr);
+            break;
+
+        case activity_t::SYSCALL: {
+            device_number = duration_intr;
+            processing_interrupt = true;
+            in_user_mode = false; // enter kernel mode by switching mode bit to 0 (false) 
+
+            // Log the interrupt boilerplate and adjust current time with its duration
+            current_time = events.interrupt(execution, current_time, duration_intr, timing);
+            charge(context, profile_activity_t::CONTEXT_SWITCH, timing.kernel_entry());
+
+            if(async_io) {
+                //The ISR starts the device and the caller blocks until the device
+                //is done, while the CPU runs whatever else is ready
+                long long done = current_time + delays[duration_intr];
+                log_event(execution, current_time, 0, events.prefix, "SYSCALL ISR: PID ", current.PID, " waits for device ",
+                          duration_intr, " until ", done, "\n");
+                log_event(execution, current_time, timing.iret, events.prefix, "IRET\n\n");
+                current_time += timing.iret;
+                charge(context, profile_activity_t::CONTEXT_SWITCH, timing.iret);
+
+                context.io_done = -1;
+                pending.schedule(done, running, duration_intr);
+                scheduler->stats.io_requests++;
+                running = NO_PROCESS;
+
+                in_user_mode = true;
+                processing_interrupt = false;
+                device_number = -1;
+                break;
+            }
+
+            log_event(execution, current_time, delays[duration_intr], events.prefix, "SYSCALL ISR\n");
+            current_time += delays[duration_intr];
+            charge(context, profile_activity_t::SYSCALL, delays[duration_intr], duration_intr);
+
+            log_event(execution, current_time, timing.iret, events.prefix, "IRET\n\n");
+            current_time += timing.iret;
+            charge(context, profile_activity_t::CONTEXT_SWITCH, timing.iret);
+
+            // Update state
+            in_user_mode = true;
+            processing_interrupt = false;
+            device_number = -1;
+            break;
+        }
+
+        case activity_t::END_IO: {
+            device_number = duration_intr;
+            processing_interrupt = true;
+            in_user_mode = false; // enter kernel mode by switching mode bit to 0 (false) 
+
+            current_time = events.interrupt(execution, current_time, duration_intr, timing);
+            charge(context, profile_activity_t::CONTEXT_SWITCH, timing.kernel_entry());
+
+            if(async_io && context.io_done == duration_intr) {
+                //The device's completion event was its interrupt and the process
+                //was blocked for the device time, so the ISR costs nothing more
+                context.io_done = -1;
+                log_event(execution, current_time, 0, events.prefix, "ENDIO ISR: device ", duration_intr, " already done\n");
+            } else {
+                //No completion to meet (no SYSCALL before it, or on another
+                //device): the END_IO line keeps its legacy cost
+                log_event(execution, current_time, delays[duration_intr], events.prefix, "ENDIO ISR\n");
+                current_time += delays[duration_intr];
+                charge(context, profile_activity_t::END_IO, delays[duration_intr], duration_intr);
+            }
+
+            log_event(execution, current_time, timing.iret, events.prefix, "IRET\n\n");
+            current_time += timing.iret;
+            charge(context, profile_activity_t::CONTEXT_SWITCH, timing.iret);
+
+            // Update state
+            in_user_mode = true;
+            processing_interrupt = false;
+            device_number = -1;
+            break;
+        }
+
+        case activity_t::FORK: {
+            current_time = events.interrupt(execution, current_time, 2, timing);
+            charge(context, profile_activity_t::CONTEXT_SWITCH, timing.kernel_entry());
+
+            // Clone PCB for child
+            log_event(execution, current_time, duration_intr, events.prefix, "cloning the PCB\n");
+            current_time += duration_intr;
+            charge(context, profile_activity_t::FORK, duration_intr);
+
+            // Create child process
+            PCB child = create_child_pcb(current);
+
+            if (allocate_memory(&child)) {
+                if(index) {
+                    index->allocate(child, current_time);
+                }
+                if(legacy) {
+                    // Remove any existing processes with same PIDs
+                    table.remove(child.PID);
+
+                    // Add parent to the waiting queue as we assume the child runs first with no preemption
+                    // (moving it to the end if it is already there)
+                    table.push_back(current);
+                }
+
+                log_event(execution, current_time, 0, events.prefix, "scheduler called\n");
+                
+                log_event(execution, current_time, timing.iret, events.prefix, "IRET\n\n");
+                current_time += timing.iret;
+                charge(context, profile_activity_t::CONTEXT_SWITCH, timing.iret);
+
+                //The branch table (filled as the view's FORKs first run) tells us
+                //where the child's block is and where the parent continues from.
+                //A streamed trace has no table, its FORK is resolved here.
+                fork_branch_t streamed_branch;
+                const fork_branch_t& branch = trace_file.streamed() ? (streamed_branch = resolve_fork(trace_file, i))
+                                                                    : branch_at(trace_file, i);
+
+                context.ip = branch.parent_index + 1; // Continue with parent from IF_PARENT
+
+                //The parent and its child (if it has anything to run) are both
+                //ready now, the scheduler picks who goes first. The legacy
+                //scheduler runs the child first, on its own copy of the PCB table.
+                size_t parent = running;
+                running = NO_PROCESS;
+                make_ready(parent);
+
+                if(!legacy) {
+                    table.push_back(child);
+                }
+                size_t child_slot = NO_PROCESS;
+                if(branch.child->size() != 0 || !legacy) {
+                    std::shared_ptr<const trace_view_t> owner = processes[parent].view_owner;
+                    if(streamed_branch.child) {
+                        owner = std::move(streamed_branch.child);
+                    }
+                    child_slot = add_process(child, branch.child ? branch.child.get() : owner.get());
+                    processes[child_slot].view_owner = std::move(owner);
+                    if(profile) {
+                        processes[child_slot].frame = profile->push(processes[parent].frame, child);
+                    }
+                    make_ready(child_slot);
+                }
+
+                // Add system status output
+                if(!legacy) {
+                    dispatch();
+                }
+                if(snapshots.due()) {
+                    write_snapshot(source.str(instruction.line_id), legacy ? child : processes[running].pcb);
+                }
+
+                //The legacy child runs next, to its end: a large one can be
+                //rendered by a worker while we run it dry
+                if(fork_pool && child_slot != NO_PROCESS && dry_run == NO_PROCESS && checkpoint_at < 0
+                   && processes[child_slot].view->size() >= fork_grain && execution.splices() < 4 * fork_pool->workers()) {
+                    render_subtree(child_slot, execution, system_status);
+                }
+
+            } else {
+                if(!renderer) {
+                    std::cerr << "ERROR: Memory allocation failed for child process!" << std::endl;
+                }
+                log_event(execution, current_time, 0, events.prefix, "memory allocation failed for child\n\n");
+                if(profile) {
+                    profile->allocation_failed(current.PID);
+                }
+            }
+            break;
+        }
+
+        case activity_t::EXEC: {
+            const std::string& program_name = source.str(instruction.program_id);
+            current_time = events.interrupt(execution, current_time, 3, timing);
+            charge(context, profile_activity_t::CONTEXT_SWITCH, timing.kernel_entry());
+
+            ///////////////////////////////////////////////////////////////////////////////////////////
+            //Add your EXEC output here
+            // Get program size from external files
+            unsigned int program_size = get_size(program_name, external_files);
+            log_event(execution, current_time, duration_intr, events.prefix, "Program is ", program_size, " Mb large\n");
+            current_time += duration_intr;
+            charge(context, profile_activity_t::EXEC, duration_intr);
+
+
+            // Create temporary PCB to check memory allocation
+            program_id_t program = program_names().intern(program_name);
+            PCB temp_pcb = current;
+            temp_pcb.program = program;
+            temp_pcb.size = program_size;
+            temp_pcb.partition_number = -1;
+
+            // UPDATE PCB TABLE - Remove old entries for this PID
+            if(legacy) {
+                table.remove(current.PID);
+            }
+
+
+            // Use existing allocate_memory function to find and allocate memory
+            if (allocate_memory(&temp_pcb)) {
+                // Free old memory if different from current (only if partition changed)
+                int released = -1;
+                if(current.partition_number != temp_pcb.partition_number && current.partition_number != -1) {
+                    released = current.partition_number;
+                    free_memory(&current);
+                }
+
+                //From here on the time is the new program's
+                if(profile) {
+                    context.frame = profile->replace(context.frame, temp_pcb);
+                }
+
+                // Loading program into memory (15ms per Mb in the legacy timing)
+                int load_time = program_size * timing.load_per_mb;
+                log_event(execution, current_time, load_time, events.prefix, "loading program into memory\n");
+                current_time += load_time;
+                charge(context, profile_activity_t::LOAD, load_time);
+
+                // Mark partition as occupied and update PCB
+                log_event(execution, current_time, timing.mark_partition, events.prefix, "marking partition as occupied\n");
+                current_time += timing.mark_partition;
+                charge(context, profile_activity_t::EXEC, timing.mark_partition);
+
+                // Update current process with new program information
+                current.program = program;
+                current.size = program_size;
+                current.partition_number = temp_pcb.partition_number;
+                auto priority = config.priorities.find(program_name);
+                if(priority != config.priorities.end()) {
+                    current.priority = priority->second;
+                }
+                if(!legacy) {
+                    table.update(current);
+                }
+                //The index sees the memory and the PCB change together, when the PCB is updated
+                if(index) {
+                    if(released != -1) {
+                        index->release(released, current_time);
+                    }
+                    index->allocate(current, current_time);
+                    index->process(current, current_time);
+                }
+
+                log_event(execution, current_time, timing.update_pcb, events.prefix, "updating PCB\n");
+                current_time += timing.update_pcb;
+                charge(context, profile_activity_t::EXEC, timing.update_pcb);
+
+                log_event(execution, current_time, 0, events.prefix, "scheduler called\n");
+                
+                log_event(execution, current_time, timing.iret, events.prefix, "IRET\n\n");
+                current_time += timing.iret;
+                charge(context, profile_activity_t::CONTEXT_SWITCH, timing.iret);
+
+                if(!legacy) {
+                    make_ready(running);
+                    dispatch();
+                }
+
+                // Add system status output
+                if(snapshots.due()) {
+                    write_snapshot(source.str(instruction.line_id), processes[running].pcb);
+                }
+
+                // Load and execute the external program (compiled once, then served from the cache)
+                auto exec_image = program_cache.get(program_name, !renderer);
+
+                if(!exec_image) {
+                    if(!renderer) {
+                        std::cerr << "ERROR: Cannot open program file " << program_name + ".txt" << std::endl;
+                    }
+                    break;
+                }
+
+                // Important: After EXEC, the current process is replaced, it
+                // continues with the external program and never comes back
+                context.view = &exec_image->view;
+                context.ip = 0;
+                context.image = std::move(exec_image);
+                context.view_owner.reset();
+
+            } else {
+                if(!renderer) {
+                    std::cerr << "ERROR: Cannot allocate memory for program " << program_name << std::endl;
+                }
+                log_event(execution, current_time, 0, events.prefix, "memory allocation failed for program ", program_name, "\n\n");
+                if(profile) {
+                    profile->allocation_failed(current.PID);
+                }
+            }
+            break;
+        }
+
+        case activity_t::IF_CHILD:
+        case activity_t::IF_PARENT:
+        case activity_t::ENDIF:
+            // These are handled in FORK processing, just skip here
+            break;
+
+        default:
+            // Command read in line isn't recognized as a CPU or I/O burst
+            execution += events.prefix;
+            execution += source.str(instruction.program_id);
+            execution += " is not recognized as a valid input\n\n";
+            break;
+        }
+    }
+
+    //A run cut short by a checkpoint leaves no half recording behind
+    memo.abort(execution);
+
+    //The run ends when the last core is done; core 0 is left active
+    if(!cores.empty()) {
+        park_core();
+        int end_time = 0;
+        for(const auto& c : cores) {
+            end_time = std::max(end_time, c.clock);
+        }
+        activate_core(0);
+        current_time = end_time;
+    }
+
+    if(checkpoint_at >= 0) {
+        std::cerr << "Warning: the run ended at " << current_time << " ms, before --checkpoint-at; no checkpoint saved" << std::endl;
+    }
+
+    return current_time;
+}
+
+//Writes where a view is: the trace or program it comes from, then the FORK
+//positions leading from there to the view. Child views are rebuilt from that
+//path on resume, the same way the run built them.
+void simulator_t::save_view(checkpoint_writer_t& out, const trace_view_t* view) {
+    std::vector<uint64_t> forks;
+    for(; view->parent; view = view->parent) {
+        forks.push_back(view->fork);
+    }
+
+    if(view == root) {
+        out.put<uint8_t>(0);
+    } else {
+        auto image = program_cache.owner(view);
+        out.put<uint8_t>(1);
+        out.put_string(image ? image->program_name : std::string());
+    }
+
+    out.put<uint64_t>(forks.size());
+    for(auto fork = forks.rbegin(); fork != forks.rend(); ++fork) {
+        out.put(*fork);
+    }
+}
+
+//returns the view saved by save_view (the trace if the path leads nowhere,
+//which fails the reader)
+const trace_view_t* simulator_t::load_view(checkpoint_reader_t& in) {
+    const trace_view_t* view = root;
+    if(in.get<uint8_t>() != 0) {
+        auto image = program_cache.get(in.get_string());
+        if(!image) {
+            in.fail();
+            return root;
+        }
+        view = &image->view;
+    }
+
+    size_t forks = in.get_count(8);
+    for(size_t i = 0; i < forks; i++) {
+        size_t fork = in.get<uint64_t>();
+        if(view->streamed() || fork >= view->size() || (*view)[fork].activity != activity_t::FORK) {
+            in.fail();
+            return root;
+        }
+        view = branch_at(*view, fork).child.get();
+    }
+    return view;
+}
+
+//Saves the whole run: the CPU, memory, scheduler and process table, the
+//pending device events, every process context and how much output was
+//written, so the run can go on from here later (or several times over)
+void simulator_t::save_checkpoint(output_sink_t& execution, output_sink_t& system_status) {
+    //The output up to the checkpoint is in the files (written by the writer
+    //threads too, with --async-output) before the checkpoint records its size
+    execution.sync();
+    system_status.sync();
+
+    checkpoint_writer_t out;
+    out.put<uint64_t>(root->size());
+    out.put(root->source->hash());
+    save_timing_model(out, timing);
+    out.put(current_time);
+    out.put(next_pid);
+    out.put<uint64_t>(instructions_executed);
+    out.put<uint64_t>(running);
+    out.put<uint64_t>(previous);
+    out.put<uint8_t>(in_user_mode);
+    out.put<uint8_t>(processing_interrupt);
+    out.put(device_number);
+    out.put<uint64_t>(execution.bytes_written());
+    out.put<uint64_t>(system_status.bytes_written());
+
+    memory.save(out);
+    scheduler->save(out);
+    table.save(out);
+    pending.save(out);
+    snapshots.save(out);
+
+    std::vector<bool> finished(processes.size(), false);
+    for(auto slot : free_slots) {
+        finished[slot] = true;
+    }
+    out.put<uint64_t>(processes.size());
+    for(size_t slot = 0; slot < processes.size(); slot++) {
+        const process_context_t& context = processes[slot];
+        out.put<uint8_t>(!finished[slot]);
+        if(finished[slot]) {
+            continue;
+        }
+        save_pcb(out, context.pcb);
+        save_view(out, context.view);
+        out.put<uint64_t>(context.ip);
+        out.put(context.remaining);
+        out.put(context.created);
+        out.put<uint64_t>(context.table_mark);
+        out.put<uint8_t>(context.image != nullptr);
+        out.put<uint64_t>(context.core);
+        out.put(context.ready_time);
+        out.put(context.io_done);
+    }
+    out.put<uint64_t>(free_slots.size());
+    for(auto slot : free_slots) {
+        out.put<uint64_t>(slot);
+    }
+
+    //The active core's queue and clock were saved above as the scheduler and time
+    out.put<uint64_t>(cores.size());
+    out.put<uint64_t>(core);
+    for(size_t c = 0; c < cores.size(); c++) {
+        const core_t& saved = cores[c];
+        if(c != core) {
+            saved.scheduler->save(out);
+            out.put<uint64_t>(saved.running);
+            out.put<uint64_t>(saved.previous);
+            out.put(saved.clock);
+        }
+        out.put(saved.busy);
+        out.put(saved.migration);
+        out.put<uint64_t>(saved.steals);
+    }
+
+    if(out.write(checkpoint_file)) {
+        std::cout << "Checkpoint: state at " << current_time << " ms saved in " << checkpoint_file << std::endl;
+    } else {
+        std::cerr << "Error: Unable to write checkpoint: " << checkpoint_file << std::endl;
+    }
+}
+
+bool simulator_t::load_checkpoint(const std::string& filename, const trace_view_t& trace) {
+    checkpoint_reader_t in;
+    if(!in.open(filename)) {
+        return false;
+    }
+
+    root = &trace;
+    uint64_t size = in.get<uint64_t>();
+    if(size != trace.size() || in.get<uint64_t>() != trace.source->hash()) {
+        return false;
+    }
+    //The times already written were taken with the timing of the checkpoint
+    timing_model_t saved_timing = load_timing_model(in);
+    if(std::memcmp(&saved_timing, &timing, sizeof(timing)) != 0) {
+        return false;
+    }
+    current_time = in.get<int>();
+    next_pid = in.get<unsigned int>();
+    instructions_executed = in.get<uint64_t>();
+    running = in.get<uint64_t>();
+    previous = in.get<uint64_t>();
+    in_user_mode = in.get<uint8_t>() != 0;
+    processing_interrupt = in.get<uint8_t>() != 0;
+    device_number = in.get<int>();
+    resume_offsets[0] = in.get<uint64_t>();
+    resume_offsets[1] = in.get<uint64_t>();
+
+    if(!memory.load(in) || !scheduler->load(in) || !table.load(in) || !pending.load(in) || !snapshots.load(in)) {
+        return false;
+    }
+    //The run may go on with another --snapshots policy than the checkpoint's
+    table.track(snapshots.diff());
+
+    //Finished slots only need to exist, they are overwritten when reused
+    PCB unused(0, -1, "init", 1, -1);
+    processes.clear();
+    size_t slots = in.get_count();
+    for(size_t slot = 0; slot < slots && in.ok(); slot++) {
+        if(in.get<uint8_t>() == 0) {
+            processes.emplace_back(unused, root, 0, 0);
+            continue;
+        }
+        PCB pcb = load_pcb(in);
+        const trace_view_t* view = load_view(in);
+        process_context_t context(std::move(pcb), view, 0, 0);
+        context.ip = in.get<uint64_t>();
+        context.remaining = in.get<int>();
+        context.created = in.get<long long>();
+        context.table_mark = in.get<uint64_t>();
+        if(in.get<uint8_t>() != 0) {
+            //Only an EXEC sets the image, and the process then runs the program's own view
+            context.image = program_cache.owner(view);
+        }
+        context.core = in.get<uint64_t>();
+        context.ready_time = in.get<int>();
+        context.io_done = in.get<int>();
+        if(context.ip > view->size() || context.remaining < 0 || context.core >= std::max<size_t>(cores.size(), 1) || context.pcb.PID >= next_pid) {
+            in.fail();
+        }
+        processes.push_back(std::move(context));
+    }
+    free_slots.resize(in.get_count(8));
+    for(auto& slot : free_slots) {
+        slot = in.get<uint64_t>();
+        if(slot >= processes.size()) {
+            in.fail();
+        }
+    }
+
+    //The checkpoint must come from a run on as many cores. The scheduler object
+    //of core 0 holds the active core's queue now, so it moves to the active core's slot.
+    if(in.get<uint64_t>() != cores.size()) {
+        return false;
+    }
+    size_t active = in.get<uint64_t>();
+    if(!cores.empty()) {
+        if(active >= cores.size()) {
+            return false;
+        }
+        std::swap(cores[0].scheduler, cores[active].scheduler);
+        core = active;
+        step_start = current_time;
+        events.prefix = cores[core].label;
+    }
+    for(size_t c = 0; c < cores.size(); c++) {
+        core_t& saved = cores[c];
+        if(c != core) {
+            if(!saved.scheduler->load(in)) {
+                return false;
+            }
+            saved.running = in.get<uint64_t>();
+            saved.previous = in.get<uint64_t>();
+            saved.clock = in.get<int>();
+            if(!saved.scheduler->contexts_below(processes.size())
+               || (saved.running != NO_PROCESS && saved.running >= processes.size())
+               || (saved.previous != NO_PROCESS && saved.previous >= processes.size())) {
+                return false;
+            }
+        }
+        saved.busy = in.get<long long>();
+        saved.migration = in.get<long long>();
+        saved.steals = in.get<uint64_t>();
+    }
+
+    //Every context the queues and the CPU refer to must be one of those restored
+    if((running != NO_PROCESS && running >= processes.size()) || (previous != NO_PROCESS && previous >= processes.size())
+       || !scheduler->contexts_below(processes.size()) || !pending.contexts_below(processes.size())) {
+        return false;
+    }
+    return in.ok();
+}
+
+//--time-index of a resumed run: starts the index from the processes and the
+//memory the checkpoint restored. A partition no live process holds (the legacy
+//scheduler never frees them) is listed without its owner, which ended before
+//the checkpoint.
+void simulator_t::restore_index() {
+    std::vector<bool> finished(processes.size(), false);
+    for(size_t slot : free_slots) {
+        finished[slot] = true;
+    }
+    std::unordered_map<int, const PCB*> owners;
+    for(size_t slot = 0; slot < processes.size(); slot++) {
+        if(!finished[slot]) {
+            index->restore_process(processes[slot].pcb);
+            owners[processes[slot].pcb.partition_number] = &processes[slot].pcb;
+        }
+    }
+    memory.for_each_occupied([&](int partition, unsigned int size, const std::string& program_name) {
+        auto owner = owners.find(partition);
+        if(owner != owners.end()) {
+            index->restore_allocation(*owner->second);
+        } else {
+            index->restore_allocation(PCB(time_index_t::NO_PID, -1, program_name.empty() ? "?" : program_name, size, partition));
+        }
+    });
+    index->begin(current_time, running == NO_PROCESS ? time_index_t::NO_PID : processes[running].pcb.PID);
+}
+
+#endif
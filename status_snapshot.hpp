@@ -0,0 +1,163 @@
+#ifndef STATUS_SNAPSHOT_HPP_
+#define STATUS_SNAPSHOT_HPP_
+
+#include "interrupts_101299776_101187793.hpp"
+#include "event_format.hpp"
+#include "process_table.hpp"
+#include <algorithm>
+#include <map>
+
+// Writes the system status snapshots taken at every FORK and EXEC, following
+// the --snapshots policy. Tables are formatted into one reused buffer, so a
+// snapshot allocates nothing once the buffer has grown.
+//
+// In diff mode only the rows that changed since the previous snapshot are
+// written: the running process if it changed, then new PCBs and PCBs whose
+// fields or state changed, then PCBs that are no longer in the table (with
+// state "removed"), each group by PID. Only the PIDs the process table says it
+// changed, and the processes running now and at the previous snapshot, are
+// looked at, so both the output and the work grow with the number of changes
+// instead of with the number of processes at each event.
+class snapshot_writer_t {
+public:
+    snapshot_writer_t(snapshot_policy_t _policy, unsigned int _every):
+        policy(_policy), every(_every ? _every : 1) {}
+
+    bool diff() const {
+        return policy == snapshot_policy_t::DIFF;
+    }
+
+    //Counts a snapshot point
+    //returns true if a snapshot should be written for it
+    bool due() {
+        switch(policy) {
+            case snapshot_policy_t::OFF:
+                return false;
+            case snapshot_policy_t::SAMPLE:
+                return points++ % every == 0;
+            default:
+                return true;
+        }
+    }
+
+    //Writes a snapshot: the running process and, as waiting, every PCB of the
+    //process table but the one with PID `skip` (the running one, if it is in
+    //the table). In diff mode the table must track its changes.
+    void write(output_sink_t& out, long long time, std::string_view trace_line, const PCB& running,
+               process_table_t& waiting, unsigned int skip = process_table_t::NO_PID) {
+        //Only a diff depends on the snapshots before it
+        if(out.discard && policy != snapshot_policy_t::DIFF) {
+            return;
+        }
+        SIM_STAT_TIMER(PRINT_PCB);
+        SIM_STAT_COUNT(PCB_TABLES, 1);
+        SIM_STAT_COUNT(PCB_ROWS, waiting.size() + 1);
+        log_status(out, time, trace_line);
+
+        table.clear();
+        if(policy == snapshot_policy_t::DIFF) {
+            format_diff(running, waiting, skip);
+        } else {
+            table += PCB_TABLE_HEADER;
+            format_PCB_row(table, running, "running");
+            waiting.for_each([&](const PCB& pcb) {
+                if(pcb.PID != skip) {
+                    format_PCB_row(table, pcb, "waiting");
+                }
+            });
+            table += PCB_TABLE_FOOTER;
+        }
+        out.append(table);
+    }
+
+    //Writes the sampling counters and, in diff mode, the rows of the previous
+    //snapshot to a checkpoint
+    void save(checkpoint_writer_t& out) const {
+        out.put(points);
+        out.put(last_running);
+        out.put<uint64_t>(printed.size());
+        for(const auto& [pid, printed_row] : printed) {
+            out.put_string(printed_row.row);
+            save_pcb(out, printed_row.pcb);
+        }
+    }
+
+    //returns false if the checkpoint is malformed
+    bool load(checkpoint_reader_t& in) {
+        points = in.get<uint64_t>();
+        last_running = in.get<unsigned int>();
+        printed.clear();
+        size_t count = in.get_count(8);
+        for(size_t i = 0; i < count && in.ok(); i++) {
+            std::string saved_row = in.get_string();
+            PCB pcb = load_pcb(in);
+            printed.emplace(pcb.PID, printed_row_t{std::move(saved_row), pcb});
+        }
+        return in.ok();
+    }
+
+private:
+    struct printed_row_t {
+        std::string     row;
+        PCB             pcb;
+    };
+
+    void format_diff(const PCB& running, process_table_t& waiting, unsigned int skip) {
+        waiting.take_changes(changed);
+        changed.push_back(running.PID);
+        if(last_running != process_table_t::NO_PID) {
+            changed.push_back(last_running);
+        }
+        last_running = running.PID;
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+        table += PCB_TABLE_HEADER;
+        diff_row(running, "running");
+        for(auto pid : changed) {
+            const PCB* pcb = pid == running.PID || pid == skip ? nullptr : waiting.find(pid);
+            if(pcb) {
+                diff_row(*pcb, "waiting");
+            }
+        }
+        for(auto pid : changed) {
+            if(pid == running.PID || (pid != skip && waiting.find(pid))) {
+                continue;
+            }
+            auto found = printed.find(pid);
+            if(found != printed.end()) {
+                format_PCB_row(table, found->second.pcb, "removed");
+                printed.erase(found);
+            }
+        }
+        table += PCB_TABLE_FOOTER;
+    }
+
+    void diff_row(const PCB& pcb, std::string_view state) {
+        row.clear();
+        format_PCB_row(row, pcb, state);
+
+        auto found = printed.find(pcb.PID);
+        if(found == printed.end()) {
+            printed.emplace(pcb.PID, printed_row_t{row, pcb});
+            table += row;
+            return;
+        }
+        if(found->second.row != row) {
+            found->second.row = row;
+            found->second.pcb = pcb;
+            table += row;
+        }
+    }
+
+    snapshot_policy_t                       policy;
+    unsigned int                            every;
+    uint64_t                                points = 0;
+    unsigned int                            last_running = process_table_t::NO_PID; //!< diff mode: PID running at the previous snapshot
+    std::string                             table;      //!< reused formatting buffer
+    std::string                             row;
+    std::vector<unsigned int>               changed;    //!< diff mode: PIDs to look at, reused
+    std::map<unsigned int, printed_row_t>   printed;    //!< diff mode: rows of the previous snapshot, by PID
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef TASK_POOL_HPP_
+#define TASK_POOL_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads running jobs in the order they are submitted,
+// while the submitting thread goes on with its own work. Unlike the batch
+// pool (work_stealing_pool_t), jobs keep coming in while it runs; the jobs
+// hand their results back themselves (through a promise).
+class task_pool_t {
+public:
+    explicit task_pool_t(unsigned int workers) {
+        for(unsigned int worker = 0; worker < (workers ? workers : 1); worker++) {
+            threads.emplace_back(&task_pool_t::work, this);
+        }
+    }
+
+    //Runs the jobs left, then stops the workers
+    ~task_pool_t() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        ready.notify_all();
+        for(auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    task_pool_t(const task_pool_t&) = delete;
+    task_pool_t& operator=(const task_pool_t&) = delete;
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            jobs.push_back(std::move(job));
+        }
+        ready.notify_one();
+    }
+
+    size_t workers() const {
+        return threads.size();
+    }
+
+private:
+    void work() {
+        std::unique_lock<std::mutex> guard(lock);
+        while(true) {
+            ready.wait(guard, [this]() { return stopping || !jobs.empty(); });
+            if(jobs.empty()) {
+                return;
+            }
+            std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            guard.unlock();
+            job();
+            guard.lock();
+        }
+    }
+
+    std::vector<std::thread>            threads;
+    std::deque<std::function<void()>>   jobs;
+    std::mutex                          lock;
+    std::condition_variable             ready;
+    bool                                stopping = false;
+};
+
+#endif
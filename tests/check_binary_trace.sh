@@ -0,0 +1,80 @@
+#!/bin/bash
+# Converts every test trace and program with trace_converter and checks that
+# the simulator gives the same output files on the binary files as on the text
+# ones, that a checkpoint of a text run resumes on the binary trace, and that a
+# corrupted or truncated binary trace is refused with an error (not a crash).
+#
+# Usage: tests/check_binary_trace.sh <directory holding interrupts and trace_converter>
+
+bin=$(cd "$1" && pwd) || exit 1
+repo=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cp -r "$repo/programs" "$work/"
+mkdir "$work/binary_programs"
+cd "$work" || exit 1
+
+failed=0
+fail() {
+    echo "check_binary_trace: $*"
+    failed=1
+}
+
+#Programs keep their .txt name, the simulator tells the formats apart by content
+for program in programs/*.txt; do
+    "$bin/trace_converter" "$program" "binary_programs/$(basename "$program")" > /dev/null || fail "cannot convert $program"
+done
+
+tables="$repo/vector_table.txt $repo/device_table.txt $repo/external_files.txt"
+for trace in "$repo"/input_files/test_trace*.txt; do
+    name=$(basename "$trace" .txt)
+    "$bin/trace_converter" "$trace" "$name.bin" > /dev/null || fail "cannot convert $name"
+    for options in "" "--scheduler=rr --quantum=7" "--scheduler=fcfs --memory-policy=buddy"; do
+        "$bin/interrupts" "$trace" $tables $options > /dev/null 2>&1
+        mv execution.txt text_execution.txt
+        mv system_status.txt text_system_status.txt
+
+        "$bin/interrupts" "$name.bin" $tables $options > /dev/null 2>&1
+        cmp -s execution.txt text_execution.txt && cmp -s system_status.txt text_system_status.txt \
+            || fail "$name.bin differs from the text trace [$options]"
+        "$bin/interrupts" "$name.bin" $tables $options --programs-dir=binary_programs/ > /dev/null 2>&1
+        cmp -s execution.txt text_execution.txt && cmp -s system_status.txt text_system_status.txt \
+            || fail "$name.bin with binary programs differs from the text trace [$options]"
+
+        rm -f simulation.ckpt
+        "$bin/interrupts" "$trace" $tables $options --checkpoint-at=200 --checkpoint-only > /dev/null 2>&1
+        if [ -f simulation.ckpt ]; then
+            "$bin/interrupts" "$name.bin" $tables $options --resume=simulation.ckpt > /dev/null 2>&1
+            cmp -s execution.txt text_execution.txt && cmp -s system_status.txt text_system_status.txt \
+                || fail "$name.bin resumed from a text run differs [$options]"
+        fi
+    done
+done
+
+#Corrupted copies of a binary trace, at the header, a record and the strings
+good=test_trace2.bin
+size=$(stat -c %s $good)
+corrupt() {
+    cp $good bad.bin
+    printf "$2" | dd of=bad.bin bs=1 seek="$1" conv=notrunc status=none
+}
+check_refused() {
+    "$bin/interrupts" bad.bin $tables > out.txt 2>&1
+    status=$?
+    if [ $status = 0 ] || [ $status -ge 128 ] || ! grep -q "Invalid binary trace" out.txt; then
+        fail "$1 was not refused (exit status $status)"
+    fi
+}
+corrupt 8 '\x02'; check_refused "a version 2 trace"
+corrupt 12 '\x01\x02\x03\x04'; check_refused "a trace of the other byte order"
+corrupt 24 '\xff\xff\xff\x00'; check_refused "a record count past the end"
+corrupt 20 '\xff\xff\xff\xff'; check_refused "a string count past the end"
+corrupt 64 '\x09'; check_refused "an unknown opcode"
+corrupt 76 '\xff\xff\xff\x7f'; check_refused "a FORK line id past the string table"
+for cut in 1 4 $((size / 2)) 65; do
+    head -c $((size - cut)) $good > bad.bin
+    check_refused "a trace cut $cut byte(s) short"
+done
+
+[ $failed = 0 ] && echo "check_binary_trace: OK"
+exit $failed
@@ -0,0 +1,40 @@
+#!/bin/bash
+# Runs the simulator on input_files/test_trace<n>.txt and compares execution.txt
+# and system_status.txt with output_files/execution_test<n>.txt and
+# system_status_test<n>.txt, byte for byte. The options that only change how
+# the output is produced (async output, no replay, fork workers, a streamed
+# trace) must give the same files.
+#
+# Usage: tests/check_outputs.sh <directory holding the interrupts binary>
+
+bin=$(cd "$1" && pwd) || exit 1
+repo=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cp -r "$repo/programs" "$work/"
+cd "$work" || exit 1
+
+tables="$repo/vector_table.txt $repo/device_table.txt $repo/external_files.txt"
+failed=0
+for options in "" "--async-output --output-buffer=1" "--memo=off" "--fork-workers=4 --fork-grain=1" "stdin"; do
+    for trace in "$repo"/input_files/test_trace*.txt; do
+        n=$(basename "$trace" .txt)
+        n=${n#test_trace}
+        rm -f execution.txt system_status.txt
+        if [ "$options" = stdin ]; then
+            "$bin/interrupts" - $tables < "$trace" > /dev/null 2>&1
+        else
+            "$bin/interrupts" "$trace" $tables $options > /dev/null 2>&1
+        fi
+        for file in execution system_status; do
+            if ! cmp -s $file.txt "$repo/output_files/${file}_test$n.txt"; then
+                echo "check_outputs: ${file}_test$n.txt differs [${options}]"
+                diff $file.txt "$repo/output_files/${file}_test$n.txt" | head -10
+                failed=1
+            fi
+        done
+    done
+done
+
+[ $failed = 0 ] && echo "check_outputs: OK"
+exit $failed
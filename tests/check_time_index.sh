@@ -0,0 +1,65 @@
+#!/bin/bash
+# Runs the test traces with --time-index and checks that time_query gives, at
+# the time of every table in system_status.txt, the same PCB rows. The state
+# must also hold from the last change time_query reports up to that time: at
+# the change itself (for an EXEC, the release, allocation and new program all
+# recorded at once) and at a time between that change and the table.
+#
+# Usage: tests/check_time_index.sh <directory holding interrupts and time_query>
+
+bin=$(cd "$1" && pwd) || exit 1
+repo=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cp -r "$repo/programs" "$work/"
+cd "$work" || exit 1
+
+failed=0
+fail() {
+    echo "check_time_index: $*"
+    failed=1
+}
+
+#Prints the PCB rows time_query gives at a time, sorted (the status tables
+#list waiting processes in table order, time_query by PID)
+query_rows() {
+    "$bin/time_query" run.idx "$1" | grep '^| *[0-9]' | sort
+}
+
+tables="$repo/vector_table.txt $repo/device_table.txt $repo/external_files.txt"
+checked=0
+for trace in "$repo"/input_files/test_trace*.txt; do
+    name=$(basename "$trace" .txt)
+    for options in "" "--index-every=2" "--scheduler=rr --quantum=7" "--scheduler=fcfs --memory-policy=buddy --index-every=3"; do
+        "$bin/interrupts" "$trace" $tables $options --time-index=run.idx > /dev/null 2>&1
+
+        #One file of sorted rows per table, and the table times in order
+        rm -rf tables && mkdir tables
+        awk '/^time: /{ n++; t = $2; sub(";", "", t); print n, t > "tables/times" }
+             /^\| *[0-9]/{ print > ("tables/" n) }' system_status.txt
+        [ -f tables/times ] || continue
+        while read -r n time; do
+            #Of tables taken at the same time only the last shows the state then
+            next=$(awk -v n=$((n + 1)) '$1 == n { print $2 }' tables/times)
+            [ "$next" = "$time" ] && continue
+            expected=$(sort "tables/$n" 2> /dev/null)
+
+            [ "$(query_rows "$time")" = "$expected" ] || fail "$name [$options]: the state at $time differs"
+            last=$("$bin/time_query" run.idx "$time" | sed -n 's/.*last change at \([0-9]*\) ms.*/\1/p')
+            if [ -z "$last" ]; then
+                fail "$name [$options]: no change before $time"
+                continue
+            fi
+            [ "$(query_rows "$last")" = "$expected" ] || fail "$name [$options]: the state at $last (last change before $time) differs"
+            if [ $((time - last)) -ge 2 ]; then
+                between=$(((last + time) / 2))
+                [ "$(query_rows "$between")" = "$expected" ] || fail "$name [$options]: the state at $between differs"
+            fi
+            checked=$((checked + 1))
+        done < tables/times
+    done
+done
+
+[ $checked -gt 0 ] || fail "no status table was checked"
+[ $failed = 0 ] && echo "check_time_index: OK ($checked tables)"
+exit $failed
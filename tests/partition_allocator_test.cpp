@@ -0,0 +1,335 @@
+/**
+ *
+ * @file partition_allocator_test.cpp
+ *
+ * Checks the partition table of partition_allocator.hpp: the three fixed-table
+ * placements against a linear scan of the partitions, buddy splits and merges,
+ * the fragmentation counters, and that a checkpoint of the table loads back
+ * while a malformed one is refused.
+ *
+ */
+
+#include "test_check.hpp"
+#include "partition_allocator.hpp"
+#include <algorithm>
+#include <random>
+
+using policy_t = placement_policy_t;
+
+// The fixed table the obvious way: every allocation scans all the partitions
+struct reference_table_t {
+    policy_t                    policy;
+    std::vector<unsigned int>   sizes;
+    std::vector<unsigned int>   used;   //!< program size in each partition, 0 when free
+
+    //returns the partition number, or -1
+    int allocate(unsigned int size) {
+        int chosen = -1;
+        for(size_t i = 0; i < sizes.size(); i++) {
+            if(used[i] || sizes[i] < size) {
+                continue;
+            }
+            bool better = chosen < 0;
+            if(!better && policy == policy_t::BEST_FIT) {
+                better = sizes[i] <= sizes[chosen];     //ties: highest partition number
+            }
+            if(!better && policy == policy_t::WORST_FIT) {
+                better = sizes[i] > sizes[chosen];      //ties: lowest partition number
+            }
+            if(better) {
+                chosen = i;
+            }
+        }
+        if(chosen >= 0) {
+            used[chosen] = size;
+        }
+        return chosen < 0 ? -1 : chosen + 1;
+    }
+
+    unsigned int total_free() const {
+        unsigned int total = 0;
+        for(size_t i = 0; i < sizes.size(); i++) {
+            total += used[i] ? 0 : sizes[i];
+        }
+        return total;
+    }
+};
+
+//Runs the same random allocations and frees on a table and on the reference
+void check_against_reference(policy_t policy, unsigned int seed) {
+    std::mt19937 random(seed);
+    std::vector<unsigned int> sizes(1 + random() % 40);
+    for(auto& size : sizes) {
+        size = 1 + random() % 50;
+    }
+    partition_table_t memory(sizes, policy);
+    reference_table_t reference{policy, sizes, std::vector<unsigned int>(sizes.size(), 0)};
+
+    size_t allocations = 0, failures = 0, fragmented = 0, frees = 0;
+    for(int step = 0; step < 2000; step++) {
+        if(random() % 3) {
+            unsigned int size = 1 + random() % 60;
+            bool fits_in_total = reference.total_free() >= size;
+            int expected = reference.allocate(size);
+            CHECK(memory.allocate(size, "p" + std::to_string(step)) == expected);
+            allocations += expected > 0;
+            failures += expected < 0;
+            fragmented += expected < 0 && fits_in_total;
+        } else {
+            //Partition numbers out of the table and free partitions are ignored
+            int number = static_cast<int>(random() % (sizes.size() + 2));
+            if(number >= 1 && number <= static_cast<int>(sizes.size()) && reference.used[number - 1]) {
+                reference.used[number - 1] = 0;
+                frees++;
+            }
+            memory.release(number);
+        }
+
+        unsigned int largest = 0;
+        unsigned long lost = 0;
+        for(size_t i = 0; i < sizes.size(); i++) {
+            largest = reference.used[i] ? largest : std::max(largest, sizes[i]);
+            lost += reference.used[i] ? sizes[i] - reference.used[i] : 0;
+        }
+        CHECK(memory.total_free == reference.total_free());
+        CHECK(memory.largest_free() == largest);
+        CHECK(memory.internal_fragmentation() == lost);
+    }
+    CHECK(memory.stats.allocations == allocations);
+    CHECK(memory.stats.failures == failures);
+    CHECK(memory.stats.fragmented_failures == fragmented);
+    CHECK(memory.stats.frees == frees);
+}
+
+//The placements on the assignment's table, by hand
+void check_default_table() {
+    //Partitions 1-6: 40, 25, 15, 10, 8, 2 Mb
+    partition_table_t best(default_partition_sizes(), policy_t::BEST_FIT);
+    CHECK(best.allocate(9, "a") == 4);
+    CHECK(best.allocate(9, "b") == 3);
+    CHECK(best.allocate(41, "c") == -1);
+    CHECK(best.stats.fragmented_failures == 1);
+
+    partition_table_t first(default_partition_sizes(), policy_t::FIRST_FIT);
+    CHECK(first.allocate(9, "a") == 1);
+    CHECK(first.allocate(9, "b") == 2);
+    CHECK(first.allocate(2, "c") == 3);
+
+    partition_table_t worst(default_partition_sizes(), policy_t::WORST_FIT);
+    CHECK(worst.allocate(1, "a") == 1);
+    CHECK(worst.allocate(1, "b") == 2);
+    CHECK(worst.allocate(16, "c") == -1);
+    worst.release(1);
+    CHECK(worst.allocate(16, "c") == 1);
+    CHECK(worst.partitions[0].code == "c");
+
+    //Ties: best fit takes the highest partition number, worst fit the lowest
+    partition_table_t best_tie({5, 5, 5}, policy_t::BEST_FIT);
+    CHECK(best_tie.allocate(5, "a") == 3);
+    partition_table_t worst_tie({5, 5, 5}, policy_t::WORST_FIT);
+    CHECK(worst_tie.allocate(5, "a") == 1);
+}
+
+//Splits and merges of a 64 Mb buddy memory with 4 Mb blocks at least
+void check_buddy() {
+    partition_table_t memory({}, policy_t::BUDDY, 64, 4);
+    CHECK(memory.buddy_size == 64);
+    CHECK(memory.buddy_free.size() == 5);
+
+    CHECK(memory.allocate(5, "a") == 1);    //8 Mb at 0: splits 64 into 32, 16, 8
+    CHECK(memory.buddy_free[1] == std::set<unsigned int>{8});
+    CHECK(memory.buddy_free[2] == std::set<unsigned int>{16});
+    CHECK(memory.buddy_free[3] == std::set<unsigned int>{32});
+    CHECK(memory.allocate(8, "b") == 3);    //the 8 Mb buddy at 8
+    CHECK(memory.allocate(30, "c") == 9);   //32 Mb at 32
+    CHECK(memory.internal_fragmentation() == 3 + 0 + 2);
+    CHECK(memory.total_free == 16);
+    CHECK(memory.largest_free() == 16);
+
+    CHECK(memory.allocate(20, "d") == -1);  //not enough memory at all
+    CHECK(memory.stats.fragmented_failures == 0);
+    CHECK(memory.allocate(16, "e") == 5);
+    CHECK(memory.total_free == 0);
+    CHECK(memory.largest_free() == 0);
+
+    memory.release(1);
+    memory.release(5);
+    CHECK(memory.total_free == 24);
+    CHECK(memory.allocate(20, "f") == -1);  //24 Mb free, in 8 and 16 Mb blocks apart
+    CHECK(memory.stats.fragmented_failures == 1);
+    CHECK(memory.largest_free() == 16);
+
+    memory.release(3);                      //8 at 0 and 8 merge, then with 16 at 16
+    CHECK(memory.buddy_free[3] == std::set<unsigned int>{0});
+    CHECK(memory.buddy_free[1].empty() && memory.buddy_free[2].empty());
+    memory.release(9);                      //then with 32 at 32
+    CHECK(memory.total_free == 64);
+    CHECK(memory.largest_free() == 64);
+    CHECK(memory.buddy_free[4] == std::set<unsigned int>{0});
+    for(size_t order = 0; order < 4; order++) {
+        CHECK(memory.buddy_free[order].empty());
+    }
+    CHECK(memory.buddy_used.empty());
+    CHECK(memory.stats.allocations == 4);
+    CHECK(memory.stats.failures == 2);
+    CHECK(memory.stats.frees == 4);
+
+    //Without an explicit size, the memory is the partitions' total, rounded up
+    partition_table_t rounded(default_partition_sizes(), policy_t::BUDDY);
+    CHECK(rounded.buddy_size == 128);
+    CHECK(rounded.allocate(129, "g") == -1);
+}
+
+//Random buddy allocations: free and used blocks always tile the memory, and
+//no two free buddies are left unmerged
+void check_buddy_random(unsigned int seed) {
+    std::mt19937 random(seed);
+    partition_table_t memory({}, policy_t::BUDDY, 256, 2);
+    std::vector<int> numbers;
+    for(int step = 0; step < 3000; step++) {
+        if(numbers.empty() || random() % 2) {
+            int number = memory.allocate(1 + random() % 70, "p");
+            if(number > 0) {
+                numbers.push_back(number);
+            }
+        } else {
+            size_t pick = random() % numbers.size();
+            memory.release(numbers[pick]);
+            numbers.erase(numbers.begin() + pick);
+        }
+
+        std::vector<int> owner(memory.buddy_size, 0);
+        unsigned int free_total = 0;
+        auto cover = [&](unsigned int offset, size_t order, int mark) {
+            for(unsigned int i = offset; i < offset + (memory.buddy_min << order); i++) {
+                CHECK(owner[i] == 0);
+                owner[i] = mark;
+            }
+        };
+        for(size_t order = 0; order < memory.buddy_free.size(); order++) {
+            for(auto offset : memory.buddy_free[order]) {
+                cover(offset, order, 1);
+                free_total += memory.buddy_min << order;
+                if(order + 1 < memory.buddy_free.size()) {
+                    CHECK(memory.buddy_free[order].count(offset ^ (memory.buddy_min << order)) == 0);
+                }
+            }
+        }
+        for(const auto& [offset, block] : memory.buddy_used) {
+            cover(offset, block.first, 2);
+            CHECK((memory.buddy_min << block.first) >= block.second);
+        }
+        CHECK(std::count(owner.begin(), owner.end(), 0) == 0);
+        CHECK(memory.total_free == free_total);
+        CHECK(memory.buddy_used.size() == numbers.size());
+    }
+}
+
+//returns true if `saved` loads into a new table of `policy`, and then places
+//programs where `saved` does
+bool loads_back(partition_table_t saved, policy_t policy) {
+    checkpoint_writer_t out;
+    saved.save(out);
+    checkpoint_reader_t in;
+    partition_table_t loaded(default_partition_sizes(), policy);
+    if(!reopen_checkpoint(out, in) || !loaded.load(in)) {
+        return false;
+    }
+    CHECK(loaded.total_free == saved.total_free);
+    CHECK(loaded.stats.allocations == saved.stats.allocations);
+    CHECK(loaded.stats.fragmented_failures == saved.stats.fragmented_failures);
+    if(loaded.policy == saved.policy) {
+        std::mt19937 random(7);
+        for(int step = 0; step < 200; step++) {
+            unsigned int size = 1 + random() % 40;
+            CHECK(loaded.allocate(size, "x") == saved.allocate(size, "x"));
+            int number = 1 + random() % 8;
+            loaded.release(number);
+            saved.release(number);
+        }
+    }
+    return true;
+}
+
+//returns true if a table saved after `corrupt` changed it is loaded
+template<typename corrupt_t>
+bool loads_corrupted(const partition_table_t& table, corrupt_t corrupt) {
+    partition_table_t copy = table;
+    corrupt(copy);
+    checkpoint_writer_t out;
+    copy.save(out);
+    checkpoint_reader_t in;
+    partition_table_t loaded(default_partition_sizes(), table.policy);
+    return reopen_checkpoint(out, in) && loaded.load(in);
+}
+
+void check_checkpoint() {
+    std::vector<unsigned int> sizes = {12, 7, 30, 7, 2, 19, 40};
+    partition_table_t fixed(sizes, policy_t::BEST_FIT);
+    fixed.allocate(6, "a");
+    fixed.allocate(25, "b");
+    fixed.allocate(50, "c");
+    CHECK(loads_back(fixed, policy_t::BEST_FIT));
+    CHECK(loads_back(fixed, policy_t::FIRST_FIT));  //another fixed placement may resume it
+    CHECK(!loads_back(fixed, policy_t::BUDDY));
+
+    partition_table_t buddy({}, policy_t::BUDDY, 128, 4);
+    buddy.allocate(20, "a");
+    buddy.allocate(3, "b");
+    CHECK(loads_back(buddy, policy_t::BUDDY));
+    CHECK(!loads_back(buddy, policy_t::WORST_FIT));
+
+    //A table that does not add up is refused, not trusted with the next allocation
+    CHECK(loads_corrupted(fixed, [](partition_table_t&) {}));
+    CHECK(!loads_corrupted(fixed, [](partition_table_t& t) { t.occupied[0] = !t.occupied[0]; }));
+    CHECK(!loads_corrupted(fixed, [](partition_table_t& t) { t.max_free[t.leaves] += 1; }));
+    CHECK(!loads_corrupted(fixed, [](partition_table_t& t) { t.max_free[1] = 0; }));
+    CHECK(!loads_corrupted(fixed, [](partition_table_t& t) { t.free_by_size.erase(t.free_by_size.begin()); }));
+    CHECK(!loads_corrupted(fixed, [](partition_table_t& t) { t.leaves = 3; }));
+    CHECK(!loads_corrupted(fixed, [](partition_table_t& t) { t.total_free++; }));
+    CHECK(!loads_corrupted(fixed, [](partition_table_t& t) {
+        t.partitions.pop_back();
+        t.occupied.pop_back();
+        t.occupied_size.pop_back();
+    }));
+
+    CHECK(loads_corrupted(buddy, [](partition_table_t&) {}));
+    CHECK(!loads_corrupted(buddy, [](partition_table_t& t) { t.buddy_min = 0; }));
+    CHECK(!loads_corrupted(buddy, [](partition_table_t& t) { t.buddy_size = 96; }));
+    CHECK(!loads_corrupted(buddy, [](partition_table_t& t) { t.buddy_free[2].insert(6); }));
+    CHECK(!loads_corrupted(buddy, [](partition_table_t& t) { t.buddy_free[0].insert(128); }));
+    CHECK(!loads_corrupted(buddy, [](partition_table_t& t) { t.buddy_used.begin()->second.first = 9; }));
+    CHECK(!loads_corrupted(buddy, [](partition_table_t& t) { t.buddy_used[130] = {0, 1}; }));
+    CHECK(!loads_corrupted(buddy, [](partition_table_t& t) { t.total_free = 1000; }));
+
+    //Every truncation of the file is refused
+    checkpoint_writer_t out;
+    fixed.save(out);
+    for(size_t cut = 1; cut < 64; cut++) {
+        checkpoint_reader_t in;
+        partition_table_t loaded(sizes, policy_t::BEST_FIT);
+        bool opened = reopen_checkpoint(out, in, [cut](std::string& bytes) { bytes.resize(bytes.size() - cut); });
+        CHECK(!opened || !loaded.load(in));
+    }
+
+    //So is a checkpoint of another version or byte order
+    for(size_t offset : {0, 8, 12}) {
+        checkpoint_reader_t in;
+        CHECK(!reopen_checkpoint(out, in, [offset](std::string& bytes) { bytes[offset] ^= 1; }));
+    }
+}
+
+int main() {
+    check_default_table();
+    for(unsigned int seed = 1; seed <= 30; seed++) {
+        check_against_reference(policy_t::BEST_FIT, seed);
+        check_against_reference(policy_t::FIRST_FIT, seed);
+        check_against_reference(policy_t::WORST_FIT, seed);
+    }
+    check_buddy();
+    for(unsigned int seed = 1; seed <= 5; seed++) {
+        check_buddy_random(seed);
+    }
+    check_checkpoint();
+    return test_result("partition_allocator_test");
+}
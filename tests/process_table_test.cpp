@@ -0,0 +1,299 @@
+/**
+ *
+ * @file process_table_test.cpp
+ *
+ * Checks the process table of process_table.hpp: table order under adds,
+ * moves, updates and removals, rollback of the journal (nested, as forked
+ * children use it), the changed-PID list, copy_live, and that a checkpoint of
+ * the table loads back while a malformed one is refused.
+ *
+ */
+
+#include "test_check.hpp"
+#include "process_table.hpp"
+#include <random>
+#include <tuple>
+
+using row_t = std::tuple<unsigned int, int, std::string, unsigned int, int, int>;
+
+//returns the table's PCBs, in table order
+std::vector<row_t> rows(const process_table_t& table) {
+    std::vector<row_t> listed;
+    table.for_each([&listed](const PCB& pcb) {
+        listed.emplace_back(pcb.PID, pcb.PPID, pcb.program_name(), pcb.size, pcb.partition_number, pcb.priority);
+    });
+    return listed;
+}
+
+PCB make_pcb(unsigned int pid, int version) {
+    PCB pcb(pid, version, "program" + std::to_string(version % 4), 1 + version % 30, version % 7 - 1);
+    pcb.priority = version % 3;
+    return pcb;
+}
+
+//One random add, move, update or removal, on the table and on a plain list
+void random_change(std::mt19937& random, process_table_t& table, std::vector<row_t>& expected, unsigned int pids) {
+    unsigned int pid = random() % pids;
+    int version = random() % 1000;
+    auto found = std::find_if(expected.begin(), expected.end(), [pid](const row_t& row) { return std::get<0>(row) == pid; });
+    PCB pcb = make_pcb(pid, version);
+    row_t row(pid, pcb.PPID, pcb.program_name(), pcb.size, pcb.partition_number, pcb.priority);
+    switch(random() % 3) {
+        case 0:     //added at the end, or moved there
+            if(found != expected.end()) {
+                expected.erase(found);
+            }
+            expected.push_back(row);
+            table.push_back(pcb);
+            break;
+        case 1:     //updated in place (added at the end if it is not in the table)
+            if(found != expected.end()) {
+                *found = row;
+            } else {
+                expected.push_back(row);
+            }
+            table.update(pcb);
+            break;
+        default:
+            if(found != expected.end()) {
+                expected.erase(found);
+            }
+            table.remove(pid);
+            break;
+    }
+}
+
+void check_order() {
+    process_table_t table;
+    table.push_back(make_pcb(0, 0));
+    table.push_back(make_pcb(1, 1));
+    table.push_back(make_pcb(2, 2));
+    table.update(make_pcb(0, 10));
+    table.push_back(make_pcb(1, 11));   //moves to the end
+    table.remove(2);
+    table.remove(7);                    //not in the table
+    CHECK(table.size() == 2);
+    CHECK(table.contains(0) && table.contains(1) && !table.contains(2) && !table.contains(7));
+    std::vector<row_t> listed = rows(table);
+    CHECK(listed.size() == 2 && std::get<0>(listed[0]) == 0 && std::get<0>(listed[1]) == 1);
+    CHECK(std::get<1>(listed[0]) == 10 && std::get<1>(listed[1]) == 11);
+    CHECK(table.find(1) && table.find(1)->PPID == 11);
+    CHECK(table.find(2) == nullptr);
+
+    std::mt19937 random(1);
+    std::vector<row_t> expected = rows(table);
+    for(int step = 0; step < 5000; step++) {
+        random_change(random, table, expected, 40);
+        CHECK(table.size() == expected.size());
+    }
+    CHECK(rows(table) == expected);
+}
+
+//Marks nested the way forked children are run: every level rolls back to the
+//table its parent had
+void check_rollback(unsigned int seed) {
+    std::mt19937 random(seed);
+    process_table_t table;
+    table.journaling = true;
+    std::vector<row_t> expected;
+    for(int step = 0; step < 50; step++) {
+        random_change(random, table, expected, 30);
+    }
+
+    std::vector<std::pair<size_t, std::vector<row_t>>> marks;
+    for(int step = 0; step < 3000; step++) {
+        unsigned int action = random() % 10;
+        if(action == 0) {
+            marks.emplace_back(table.mark(), expected);
+        } else if(action == 1 && !marks.empty()) {
+            table.rollback(marks.back().first);
+            expected = marks.back().second;
+            marks.pop_back();
+            CHECK(rows(table) == expected);
+            CHECK(table.size() == expected.size());
+        } else {
+            random_change(random, table, expected, 30);
+        }
+    }
+    while(!marks.empty()) {
+        table.rollback(marks.back().first);
+        CHECK(rows(table) == marks.back().second);
+        marks.pop_back();
+    }
+}
+
+void check_changes() {
+    process_table_t table;
+    table.push_back(make_pcb(0, 0));
+    table.push_back(make_pcb(1, 1));
+
+    //Turning tracking on lists the whole table
+    std::vector<unsigned int> pids;
+    table.track(true);
+    table.take_changes(pids);
+    CHECK(pids == (std::vector<unsigned int>{0, 1}));
+    table.take_changes(pids);
+    CHECK(pids.empty());
+
+    table.journaling = true;
+    size_t mark = table.mark();
+    table.update(make_pcb(1, 5));
+    table.push_back(make_pcb(3, 3));
+    table.remove(0);
+    table.take_changes(pids);
+    std::sort(pids.begin(), pids.end());
+    pids.erase(std::unique(pids.begin(), pids.end()), pids.end());
+    CHECK(pids == (std::vector<unsigned int>{0, 1, 3}));
+
+    table.rollback(mark);
+    table.take_changes(pids);
+    std::sort(pids.begin(), pids.end());
+    pids.erase(std::unique(pids.begin(), pids.end()), pids.end());
+    CHECK(pids == (std::vector<unsigned int>{0, 1, 3}));
+
+    table.track(false);
+    table.update(make_pcb(1, 6));
+    table.take_changes(pids);
+    CHECK(pids.empty());
+}
+
+void check_copy_live() {
+    process_table_t table;
+    for(unsigned int pid = 0; pid < 5; pid++) {
+        table.push_back(make_pcb(pid, pid));
+    }
+    table.remove(2);
+    process_table_t copy = table.copy_live(10);
+    CHECK(rows(copy) == rows(table));
+    copy.journaling = true;
+    size_t mark = copy.mark();
+    copy.push_back(make_pcb(10, 1));
+    copy.push_back(make_pcb(12, 2));
+    copy.remove(10);
+    CHECK(copy.size() == 5);
+    CHECK(copy.find(3) && copy.find(12) && !copy.find(10));
+    copy.rollback(mark);
+    CHECK(rows(copy) == rows(table));
+}
+
+//returns the table loaded back from a checkpoint of `table`, after checking it
+//lists the same PCBs and rolls back the same way
+void check_round_trip(unsigned int seed) {
+    std::mt19937 random(seed);
+    process_table_t table;
+    table.journaling = true;
+    table.track(true);
+    std::vector<row_t> expected;
+    for(int step = 0; step < 200; step++) {
+        random_change(random, table, expected, 50);
+    }
+    size_t mark = table.mark();
+    std::vector<row_t> at_mark = expected;
+    for(int step = 0; step < 200; step++) {
+        random_change(random, table, expected, 50);
+    }
+
+    checkpoint_writer_t out;
+    table.save(out);
+    checkpoint_reader_t in;
+    process_table_t loaded;
+    CHECK(reopen_checkpoint(out, in) && loaded.load(in));
+    CHECK(rows(loaded) == expected);
+    CHECK(loaded.size() == expected.size());
+    CHECK(loaded.journaling && loaded.track_changes);
+    std::vector<unsigned int> changes, loaded_changes;
+    table.take_changes(changes);
+    loaded.take_changes(loaded_changes);
+    CHECK(changes == loaded_changes);
+
+    loaded.rollback(mark);
+    CHECK(rows(loaded) == at_mark);
+
+    //Every truncation of the file is refused
+    for(size_t cut = 1; cut < 200; cut += 7) {
+        checkpoint_reader_t truncated;
+        process_table_t refused;
+        bool opened = reopen_checkpoint(out, truncated, [cut](std::string& bytes) { bytes.resize(bytes.size() - cut); });
+        CHECK(!opened || !refused.load(truncated));
+    }
+}
+
+// An entry of a hand-written table checkpoint: the PID of its PCB, or NO_PID
+// for an empty entry, and its links
+struct saved_entry_t {
+    unsigned int    pid;
+    unsigned int    prev;
+    unsigned int    next;
+};
+
+const unsigned int NO_PID = process_table_t::NO_PID;
+
+//returns true if a table checkpoint with these entries, links and journal loads
+bool loads(const std::vector<saved_entry_t>& entries, unsigned int head, unsigned int tail, uint64_t count,
+           const std::vector<unsigned int>& journal_pids = {}, const std::vector<unsigned int>& changed = {}) {
+    checkpoint_writer_t out;
+    out.put<uint8_t>(1);
+    out.put<uint64_t>(entries.size());
+    for(const auto& entry : entries) {
+        save_optional_pcb(out, entry.pid == NO_PID ? std::nullopt : std::optional<PCB>(make_pcb(entry.pid, 1)));
+        out.put(entry.prev);
+        out.put(entry.next);
+    }
+    out.put<uint64_t>(journal_pids.size());
+    for(auto pid : journal_pids) {
+        out.put<uint8_t>(2);    //UPDATED
+        out.put(pid);
+        save_optional_pcb(out, make_pcb(pid, 2));
+        out.put(NO_PID);
+        out.put(NO_PID);
+    }
+    out.put(head);
+    out.put(tail);
+    out.put(count);
+    out.put<uint8_t>(1);
+    out.put<uint64_t>(changed.size());
+    for(auto pid : changed) {
+        out.put(pid);
+    }
+
+    checkpoint_reader_t in;
+    process_table_t table;
+    return reopen_checkpoint(out, in) && table.load(in);
+}
+
+void check_malformed() {
+    //0 <-> 1 <-> 2, and an empty entry 3
+    std::vector<saved_entry_t> good = {{0, NO_PID, 1}, {1, 0, 2}, {2, 1, NO_PID}, {NO_PID, NO_PID, NO_PID}};
+    CHECK(loads(good, 0, 2, 3, {1}, {0, 2}));
+    CHECK(loads({}, NO_PID, NO_PID, 0));
+
+    auto with = [&good](size_t index, saved_entry_t entry) {
+        std::vector<saved_entry_t> changed = good;
+        changed[index] = entry;
+        return changed;
+    };
+    CHECK(!loads(with(1, {5, 0, 2}), 0, 2, 3));             //a PCB in another PID's entry
+    CHECK(!loads(with(1, {1, 0, 9}), 0, 2, 3));             //a link out of the table
+    CHECK(!loads(good, 9, 2, 3));
+    CHECK(!loads(good, 0, 2, 3, {4}));                      //a journal entry out of the table
+    CHECK(!loads(good, 0, 2, 3, {}, {4}));                  //a changed PID out of the table
+    CHECK(!loads(good, 3, 2, 3));                           //the list starts at an empty entry
+    CHECK(!loads(with(0, {0, NO_PID, 3}), 0, 2, 3));        //or leads to one
+    CHECK(!loads(with(2, {2, 1, 0}), 0, 2, 3));             //or goes round in a circle
+    CHECK(!loads(with(1, {1, 2, 2}), 0, 2, 3));             //a back link that does not match
+    CHECK(!loads(good, 0, 1, 3));                           //a tail that is not the end
+    CHECK(!loads(good, 0, 2, 2));                           //a count that is not the length
+    CHECK(!loads(with(3, {3, NO_PID, NO_PID}), 0, 2, 3));   //a PCB left out of the list
+}
+
+int main() {
+    check_order();
+    for(unsigned int seed = 1; seed <= 20; seed++) {
+        check_rollback(seed);
+        check_round_trip(seed);
+    }
+    check_changes();
+    check_copy_live();
+    check_malformed();
+    return test_result("process_table_test");
+}
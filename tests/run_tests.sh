@@ -0,0 +1,27 @@
+#!/bin/bash
+# Builds the simulator, its tools and the unit drivers of tests/ (*_test.cpp),
+# runs the drivers, then every check_*.sh script against the fresh build.
+#
+# Usage: tests/run_tests.sh
+
+cd "$(dirname "$0")/.." || exit 1
+build=$(mktemp -d)
+trap 'rm -rf "$build"' EXIT
+
+g++ -O2 -std=c++17 -pthread -I . -o "$build/interrupts" interrupts_101299776_101187793.cpp || exit 1
+g++ -O2 -std=c++17 -I . -o "$build/trace_converter" trace_converter.cpp || exit 1
+g++ -O2 -std=c++17 -I . -o "$build/time_query" time_query.cpp || exit 1
+
+failed=0
+for driver in tests/*_test.cpp; do
+    name=$(basename "$driver" .cpp)
+    if ! g++ -O2 -std=c++17 -pthread -I . -o "$build/$name" "$driver" || ! "$build/$name"; then
+        failed=1
+    fi
+done
+for script in tests/check_*.sh; do
+    "$script" "$build" || failed=1
+done
+
+[ $failed = 0 ] && echo "All tests passed" || echo "Some tests FAILED"
+exit $failed
@@ -0,0 +1,57 @@
+#ifndef TEST_CHECK_HPP_
+#define TEST_CHECK_HPP_
+
+#include "checkpoint.hpp"
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+// What the unit drivers of tests/ share: CHECK reports a failed condition and
+// carries on, test_result() is what main returns.
+
+int test_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            test_failures++; \
+        } \
+    } while(false)
+
+//returns the exit status of a driver, after saying how it went
+int test_result(const char* name) {
+    std::cout << name << ": " << (test_failures ? "FAILED (" + std::to_string(test_failures) + " check(s))" : std::string("OK")) << std::endl;
+    return test_failures ? 1 : 0;
+}
+
+//Writes a checkpoint through a file, lets `edit` change its bytes (the header
+//included) and opens it again
+//returns false if the reader refuses the file
+template<typename edit_t>
+bool reopen_checkpoint(const checkpoint_writer_t& out, checkpoint_reader_t& in, edit_t edit) {
+    std::string path = (std::filesystem::temp_directory_path() / ("sim_test." + std::to_string(getpid()) + ".ckpt")).string();
+    if(!out.write(path)) {
+        return false;
+    }
+    std::string bytes;
+    {
+        std::ifstream input_file(path, std::ios::binary);
+        bytes.assign((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
+    }
+    edit(bytes);
+    {
+        std::ofstream output_file(path, std::ios::binary | std::ios::trunc);
+        output_file.write(bytes.data(), bytes.size());
+    }
+    bool opened = in.open(path);
+    std::filesystem::remove(path);
+    return opened;
+}
+
+bool reopen_checkpoint(const checkpoint_writer_t& out, checkpoint_reader_t& in) {
+    return reopen_checkpoint(out, in, [](std::string&) {});
+}
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ *
+ * @file trace_binary_test.cpp
+ *
+ * Checks the binary trace format of trace_binary.hpp: a text trace written as
+ * a binary trace loads back as the same instructions and strings, and a binary
+ * trace with a bad header, a bad string table, a bad string id for its opcode
+ * or cut short anywhere is refused before any record is used.
+ *
+ */
+
+#include "test_check.hpp"
+#include "trace_binary.hpp"
+
+const char TEXT_TRACE[] =
+    "FORK, 10\n"
+    "IF_CHILD, 0\n"
+    "EXEC program1, 50\n"
+    "IF_PARENT, 0\n"
+    "CPU, 20\n"
+    "SYSCALL, 4\n"
+    "END_IO, 4\n"
+    "ENDIF, 0\n"
+    "CALIBRATE, 7\n"
+    "EXEC program2, 25\n";
+
+//returns the bytes of `trace` in the binary format
+std::string binary_bytes(const compiled_trace_t& trace) {
+    std::string path = (std::filesystem::temp_directory_path() / ("sim_test." + std::to_string(getpid()) + ".bin")).string();
+    CHECK(write_binary_trace(trace, path));
+    std::ifstream input_file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
+    std::filesystem::remove(path);
+    return bytes;
+}
+
+//returns the header of a binary trace, to edit
+binary_trace_header_t& header_of(std::string& bytes) {
+    return *reinterpret_cast<binary_trace_header_t*>(bytes.data());
+}
+
+//returns record i of a binary trace, to edit
+instruction_t& record_of(std::string& bytes, size_t i) {
+    return reinterpret_cast<instruction_t*>(bytes.data() + sizeof(binary_trace_header_t))[i];
+}
+
+//returns true if the bytes, after `edit`, are accepted as a binary trace
+template<typename edit_t>
+bool accepted(std::string bytes, edit_t edit) {
+    edit(bytes);
+    compiled_trace_t trace;
+    return read_binary_trace(bytes.data(), bytes.size(), trace);
+}
+
+void check_round_trip() {
+    compiled_trace_t text = compile_trace(TEXT_TRACE, sizeof(TEXT_TRACE) - 1);
+    std::string bytes = binary_bytes(text);
+    compiled_trace_t binary;
+    CHECK(read_binary_trace(bytes.data(), bytes.size(), binary));
+    CHECK(binary.size() == text.size());
+    CHECK(binary.strings == text.strings);
+    for(size_t i = 0; i < text.size() && i < binary.size(); i++) {
+        const instruction_t& expected = text.instruction(i);
+        const instruction_t& loaded = binary.instruction(i);
+        CHECK(loaded.activity == expected.activity);
+        CHECK(loaded.operand == expected.operand);
+        CHECK(loaded.program_id == expected.program_id);
+        CHECK(loaded.line_id == expected.line_id);
+    }
+    //A checkpoint of a run on the text trace resumes on the binary one
+    CHECK(binary.hash() == text.hash());
+    CHECK(binary.instruction(8).activity == activity_t::UNKNOWN && binary.str(binary.instruction(8).program_id) == "CALIBRATE");
+
+    //Through a file, mapped
+    std::string path = (std::filesystem::temp_directory_path() / ("sim_test." + std::to_string(getpid()) + ".bin")).string();
+    CHECK(write_binary_trace(text, path));
+    compiled_trace_t mapped;
+    CHECK(load_trace_file(path, mapped));
+    CHECK(mapped.mapped != nullptr && mapped.size() == text.size() && mapped.hash() == text.hash());
+    std::filesystem::remove(path);
+
+    //An empty trace too
+    compiled_trace_t empty = compile_trace("", 0);
+    std::string empty_bytes = binary_bytes(empty);
+    compiled_trace_t empty_loaded;
+    CHECK(read_binary_trace(empty_bytes.data(), empty_bytes.size(), empty_loaded) && empty_loaded.size() == 0);
+}
+
+void check_refused() {
+    compiled_trace_t text = compile_trace(TEXT_TRACE, sizeof(TEXT_TRACE) - 1);
+    const std::string bytes = binary_bytes(text);
+    const int strings = static_cast<int>(text.strings.size());
+    CHECK(accepted(bytes, [](std::string&) {}));
+
+    //The header
+    CHECK(!accepted(bytes, [](std::string& b) { b[0] = 'X'; }));
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).version = 2; }));
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).byte_order = 0x04030201; }));
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).record_size = 12; }));
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).record_count += 1; }));
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).record_count = UINT64_MAX / 8; }));
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).strings_offset -= 1; }));
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).strings_offset = b.size() + 1; }));
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).strings_offset = UINT64_MAX; }));
+
+    //The string table
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).string_count += 1; }));
+    CHECK(!accepted(bytes, [](std::string& b) { header_of(b).string_count = UINT32_MAX; }));
+    CHECK(!accepted(bytes, [](std::string& b) {
+        uint32_t length = UINT32_MAX;
+        std::memcpy(b.data() + header_of(b).strings_offset, &length, sizeof(length));
+    }));
+
+    //The records: an opcode out of range, or a string id its opcode cannot use
+    //(record 0 is a FORK, 2 an EXEC, 4 a CPU and 8 an unknown activity)
+    CHECK(!accepted(bytes, [](std::string& b) { reinterpret_cast<uint8_t&>(record_of(b, 4).activity) = 9; }));
+    CHECK(!accepted(bytes, [](std::string& b) { reinterpret_cast<uint8_t&>(record_of(b, 4).activity) = 255; }));
+    CHECK(!accepted(bytes, [](std::string& b) { record_of(b, 0).line_id = -1; }));
+    CHECK(!accepted(bytes, [strings](std::string& b) { record_of(b, 0).line_id = strings; }));
+    CHECK(!accepted(bytes, [](std::string& b) { record_of(b, 2).program_id = -1; }));
+    CHECK(!accepted(bytes, [](std::string& b) { record_of(b, 2).line_id = -1; }));
+    CHECK(!accepted(bytes, [strings](std::string& b) { record_of(b, 2).program_id = strings; }));
+    CHECK(!accepted(bytes, [](std::string& b) { record_of(b, 4).program_id = -2; }));
+    CHECK(!accepted(bytes, [](std::string& b) { record_of(b, 4).line_id = INT32_MIN; }));
+    CHECK(!accepted(bytes, [](std::string& b) { record_of(b, 8).program_id = -1; }));
+    //while an id an opcode does not need may name any string
+    CHECK(accepted(bytes, [](std::string& b) { record_of(b, 4).program_id = 0; }));
+
+    //Every truncation
+    for(size_t size = 0; size < bytes.size(); size++) {
+        CHECK(!accepted(bytes, [size](std::string& b) { b.resize(size); }));
+    }
+
+    //load_trace_file says why it refuses a file
+    std::string path = (std::filesystem::temp_directory_path() / ("sim_test." + std::to_string(getpid()) + ".bin")).string();
+    {
+        std::string truncated = bytes.substr(0, bytes.size() - 1);
+        std::ofstream output_file(path, std::ios::binary);
+        output_file.write(truncated.data(), truncated.size());
+    }
+    compiled_trace_t trace;
+    std::streambuf* errors = std::cerr.rdbuf(nullptr);
+    CHECK(!load_trace_file(path, trace));
+    std::cerr.rdbuf(errors);
+    std::filesystem::remove(path);
+}
+
+int main() {
+    check_round_trip();
+    check_refused();
+    return test_result("trace_binary_test");
+}
@@ -0,0 +1,408 @@
+#ifndef TIME_INDEX_HPP_
+#define TIME_INDEX_HPP_
+
+#include "interrupts_101299776_101187793.hpp"
+#include "output_sink.hpp"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Time index of a run (--time-index), so the state at any time can be looked up
+// without reading the output files (see time_query.cpp). Version 1, all fields
+// in the writer's byte order:
+//
+//   offset 0                   time_index_header_t (64 bytes)
+//   offset 64                  records of 48 bytes, in time order: one per
+//                              change of the running process, the live
+//                              processes or the occupied partitions, with the
+//                              sizes of execution.txt and system_status.txt
+//                              when it happened
+//   offset directory_offset    snapshot_count time_index_entry_t: the time and
+//                              offset of every snapshot
+//   offset names_offset        name_count program names: uint32 id, uint32
+//                              length, then the bytes
+//
+// Every --index-every records, a SNAPSHOT record is followed by the records
+// that rebuild the whole state from nothing, so the state at a time is the
+// last snapshot before it (a binary search of the directory) plus the records
+// after it. A state larger than --index-every (a legacy run never frees its
+// partitions) spaces the snapshots out to one per state size worth of records,
+// so they never take more room than the changes themselves and a lookup reads
+// at most about twice the state.
+
+const char      TIME_INDEX_MAGIC[8] = {'S', 'I', 'M', 'I', 'N', 'D', 'E', 'X'};
+const uint32_t  TIME_INDEX_VERSION = 1;
+
+enum class index_change_t : uint8_t {
+    SNAPSHOT,   //!< the next `size` records are the whole state, `pid` is running
+    RUNNING,    //!< process `pid` runs (NO_PID: none)
+    PROCESS,    //!< process `pid` was created or changed (EXEC)
+    EXIT,       //!< process `pid` ended
+    ALLOCATE,   //!< `partition` was given to process `pid`
+    RELEASE     //!< `partition` was freed
+};
+
+struct time_index_record_t {
+    index_change_t  kind;
+    uint8_t         reserved[3];
+    int32_t         time;
+    uint64_t        execution_offset;   //!< bytes of execution.txt written by then
+    uint64_t        status_offset;      //!< bytes of system_status.txt written by then
+    uint32_t        pid;
+    int32_t         ppid;
+    uint32_t        program;            //!< id in the names table of the index
+    uint32_t        size;
+    int32_t         partition;
+    int32_t         priority;
+};
+static_assert(sizeof(time_index_record_t) == 48, "time index records are 48 bytes");
+
+struct time_index_entry_t {
+    int64_t         time;
+    uint64_t        offset;
+};
+
+struct time_index_header_t {
+    char            magic[8];
+    uint32_t        version;
+    uint32_t        snapshot_every;
+    uint64_t        record_count;
+    uint64_t        directory_offset;
+    uint64_t        snapshot_count;
+    uint64_t        names_offset;
+    uint64_t        name_count;
+    int64_t         end_time;           //!< -1 if the run stopped early (--checkpoint-only)
+};
+static_assert(sizeof(time_index_header_t) == 64, "the time index header is 64 bytes");
+
+// The state the records describe, as it stands after the last one applied
+struct time_index_state_t {
+    static const uint32_t NO_PID = UINT32_MAX;
+
+    time_index_record_t                             last{};             //!< the last change (its time and file offsets)
+    uint32_t                                        running = NO_PID;
+    std::map<uint32_t, time_index_record_t>         processes;          //!< live processes by PID
+    std::map<int32_t, time_index_record_t>          partitions;         //!< occupied partitions, with the process given each
+
+    void clear() {
+        last = time_index_record_t{};
+        running = NO_PID;
+        processes.clear();
+        partitions.clear();
+    }
+
+    void apply(const time_index_record_t& record) {
+        last = record;
+        switch(record.kind) {
+        case index_change_t::SNAPSHOT:
+        case index_change_t::RUNNING:
+            running = record.pid;
+            break;
+        case index_change_t::PROCESS:
+            processes[record.pid] = record;
+            break;
+        case index_change_t::EXIT:
+            processes.erase(record.pid);
+            break;
+        case index_change_t::ALLOCATE:
+            partitions[record.partition] = record;
+            break;
+        case index_change_t::RELEASE:
+            partitions.erase(record.partition);
+            break;
+        }
+    }
+};
+
+// Writes the time index of a run as it goes. The simulator reports each change
+// with the time it happens at; the file offsets come from the output sinks.
+class time_index_t {
+public:
+    static const uint32_t NO_PID = time_index_state_t::NO_PID;
+
+    //returns false if the file cannot be written
+    bool open(const std::string& filename, uint32_t every) {
+        file.open(filename, std::ios::binary | std::ios::trunc);
+        if(!file.is_open()) {
+            return false;
+        }
+        snapshot_every = every;
+        time_index_header_t header{};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        position = sizeof(header);
+        return true;
+    }
+
+    //The sinks whose sizes the records carry
+    void attach(const output_sink_t* execution, const output_sink_t* system_status) {
+        execution_sink = execution;
+        status_sink = system_status;
+    }
+
+    //A resumed run starts from the state of its checkpoint: its live processes
+    //and occupied partitions are restored before begin()
+    void restore_process(const PCB& pcb) {
+        state.apply(with_pcb(make(index_change_t::PROCESS, 0), pcb));
+    }
+
+    void restore_allocation(const PCB& owner) {
+        state.apply(with_pcb(make(index_change_t::ALLOCATE, 0), owner));
+    }
+
+    //Starts the records at `time` (0, or the time of the restored checkpoint),
+    //with the state so far as the first snapshot and process `pid` running
+    void begin(int time, uint32_t pid) {
+        state.running = pid;
+        snapshot(time);
+    }
+
+    void running(uint32_t pid, int time) {
+        if(pid == state.running) {
+            return;
+        }
+        time_index_record_t record = make(index_change_t::RUNNING, time);
+        record.pid = pid;
+        append(record);
+    }
+
+    void process(const PCB& pcb, int time) {
+        append(with_pcb(make(index_change_t::PROCESS, time), pcb));
+    }
+
+    void exit(uint32_t pid, int time) {
+        time_index_record_t record = make(index_change_t::EXIT, time);
+        record.pid = pid;
+        append(record);
+    }
+
+    void allocate(const PCB& pcb, int time) {
+        append(with_pcb(make(index_change_t::ALLOCATE, time), pcb));
+    }
+
+    void release(int partition, int time) {
+        time_index_record_t record = make(index_change_t::RELEASE, time);
+        record.partition = partition;
+        append(record);
+    }
+
+    //Writes the directory, the names and the header
+    //returns false if the file could not be written
+    bool close(long long end_time) {
+        if(!file.is_open()) {
+            return false;
+        }
+        time_index_header_t header{};
+        std::memcpy(header.magic, TIME_INDEX_MAGIC, sizeof(header.magic));
+        header.version = TIME_INDEX_VERSION;
+        header.snapshot_every = snapshot_every;
+        header.record_count = record_count;
+        header.end_time = end_time;
+
+        header.directory_offset = position;
+        header.snapshot_count = directory.size();
+        file.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(time_index_entry_t));
+        position += directory.size() * sizeof(time_index_entry_t);
+
+        header.names_offset = position;
+        header.name_count = names.size();
+        for(uint32_t id : names) {
+            const std::string& name = program_names().name(id);
+            uint32_t length = name.size();
+            file.write(reinterpret_cast<const char*>(&id), sizeof(id));
+            file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            file.write(name.data(), length);
+        }
+
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.close();
+        return !file.fail();
+    }
+
+private:
+    time_index_record_t make(index_change_t kind, int time) const {
+        time_index_record_t record{};
+        record.kind = kind;
+        record.time = time;
+        record.execution_offset = execution_sink ? execution_sink->bytes_written() : 0;
+        record.status_offset = status_sink ? status_sink->bytes_written() : 0;
+        record.pid = NO_PID;
+        record.ppid = -1;
+        record.partition = -1;
+        return record;
+    }
+
+    time_index_record_t with_pcb(time_index_record_t record, const PCB& pcb) {
+        record.pid = pcb.PID;
+        record.ppid = pcb.PPID;
+        record.program = pcb.program;
+        record.size = pcb.size;
+        record.partition = pcb.partition_number;
+        record.priority = pcb.priority;
+        names.insert(pcb.program);
+        return record;
+    }
+
+    void append(const time_index_record_t& record) {
+        write(record);
+        state.apply(record);
+        if(++since_snapshot >= snapshot_every && since_snapshot >= state.processes.size() + state.partitions.size()) {
+            snapshot(record.time);
+        }
+    }
+
+    void write(const time_index_record_t& record) {
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        position += sizeof(record);
+        record_count++;
+    }
+
+    //Writes the whole state, as of the last change
+    void snapshot(int time) {
+        directory.push_back({time, position});
+        time_index_record_t header = make(index_change_t::SNAPSHOT, time);
+        header.pid = state.running;
+        header.size = state.processes.size() + state.partitions.size();
+        write(header);
+        for(const auto& [pid, record] : state.processes) {
+            write(record);
+        }
+        for(const auto& [partition, record] : state.partitions) {
+            write(record);
+        }
+        since_snapshot = 0;
+    }
+
+    std::ofstream                       file;
+    uint64_t                            position = 0;
+    uint64_t                            record_count = 0;
+    uint32_t                            snapshot_every = 256;
+    uint32_t                            since_snapshot = 0;
+    std::vector<time_index_entry_t>     directory;
+    std::set<program_id_t>              names;
+    time_index_state_t                  state;
+    const output_sink_t*                execution_sink = nullptr;
+    const output_sink_t*                status_sink = nullptr;
+};
+
+// Looks states up in a time index, reading only the header, the names, about
+// log2(snapshot count) directory entries and one snapshot with the records after it
+class time_index_reader_t {
+public:
+    //returns false if the file cannot be opened or is not a time index of this version
+    bool open(const std::string& filename) {
+        file.open(filename, std::ios::binary);
+        if(!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header))
+           || std::memcmp(header.magic, TIME_INDEX_MAGIC, sizeof(header.magic)) != 0 || header.version != TIME_INDEX_VERSION) {
+            return false;
+        }
+
+        file.seekg(header.names_offset);
+        for(uint64_t n = 0; n < header.name_count; n++) {
+            uint32_t id = 0;
+            uint32_t length = 0;
+            file.read(reinterpret_cast<char*>(&id), sizeof(id));
+            file.read(reinterpret_cast<char*>(&length), sizeof(length));
+            std::string name(length, '\0');
+            file.read(name.data(), length);
+            names[id] = std::move(name);
+        }
+        return !file.fail();
+    }
+
+    const time_index_header_t& info() const {
+        return header;
+    }
+
+    //returns the time the index starts at (that of the checkpoint, for a resumed run)
+    long long start_time() {
+        return header.snapshot_count > 0 ? entry(0).time : 0;
+    }
+
+    //returns the name of a program id of the records
+    const std::string& name(uint32_t program) const {
+        static const std::string unknown = "?";
+        auto found = names.find(program);
+        return found == names.end() ? unknown : found->second;
+    }
+
+    //Rebuilds the state after every change up to `time` (included)
+    //returns false if the file cannot be read
+    bool state_at(long long time, time_index_state_t& state) {
+        state.clear();
+
+        //The last snapshot taken at or before `time`
+        uint64_t low = 0;
+        uint64_t high = header.snapshot_count;
+        while(low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            if(entry(middle).time <= time) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if(low == 0) {
+            return !file.fail();
+        }
+
+        file.seekg(entry(low - 1).offset);
+        time_index_record_t record;
+        if(!read(record) || record.kind != index_change_t::SNAPSHOT) {
+            return false;
+        }
+        state.apply(record);
+        time_index_record_t snapshot = record;
+        for(uint32_t k = 0; k < snapshot.size && read(record); k++) {
+            state.apply(record);
+        }
+        state.last = snapshot;
+
+        //Then the changes after it, up to `time`
+        while(static_cast<uint64_t>(file.tellg()) < header.directory_offset && read(record)) {
+            if(record.kind == index_change_t::SNAPSHOT || record.time > time) {
+                break;
+            }
+            state.apply(record);
+        }
+        return !file.fail();
+    }
+
+private:
+    time_index_entry_t entry(uint64_t n) {
+        time_index_entry_t found{};
+        file.seekg(header.directory_offset + n * sizeof(time_index_entry_t));
+        file.read(reinterpret_cast<char*>(&found), sizeof(found));
+        return found;
+    }
+
+    bool read(time_index_record_t& record) {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&record), sizeof(record)));
+    }
+
+    std::ifstream                       file;
+    time_index_header_t                 header{};
+    std::map<uint32_t, std::string>     names;
+};
+
+//Opens the --time-index file of a run. A batch run gives the directory of the
+//trace's output, where the file goes under its own name.
+//returns nullptr (after saying so) if it cannot be written
+std::unique_ptr<time_index_t> open_time_index(const sim_options_t& options, const std::filesystem::path& directory = {}) {
+    std::string filename = directory.empty() ? options.time_index_file
+                                             : (directory / std::filesystem::path(options.time_index_file).filename()).string();
+    auto index = std::make_unique<time_index_t>();
+    if(!index->open(filename, options.index_every)) {
+        std::cerr << "Error opening file " << filename << "!" << std::endl;
+        return nullptr;
+    }
+    return index;
+}
+
+#endif
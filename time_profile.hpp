@@ -0,0 +1,180 @@
+#ifndef TIME_PROFILE_HPP_
+#define TIME_PROFILE_HPP_
+
+#include "interrupts_101299776_101187793.hpp"
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Where the simulated time went (--time-profile, --pid-summary). Every timed
+// event is charged to the process it ran for, under the chain of processes
+// that forked it: a stack of "<program> (PID <n>)" frames topped by what the
+// time was spent on. EXEC swaps the program of the top frame.
+
+// What a timed event spent its time on (the last frame of its stack)
+enum class profile_activity_t {
+    CPU,            //!< CPU burst
+    SYSCALL,        //!< SYSCALL ISR, by device
+    END_IO,         //!< END_IO ISR, by device
+    FORK,           //!< cloning the PCB
+    EXEC,           //!< EXEC ISR: sizing the program, marking the partition, updating the PCB
+    LOAD,           //!< loading the program of an EXEC into memory
+    CONTEXT_SWITCH, //!< kernel entry (mode switch, context save, vector lookup) and IRET
+    MIGRATION,      //!< --cores: taking in a process stolen from another core
+    IDLE            //!< every process waits for a device (charged to no process)
+};
+
+// The per-PID totals of --pid-summary, in ms
+struct pid_times_t {
+    program_id_t    program{};                  //!< the last program the process ran
+    long long       cpu = 0;
+    long long       isr = 0;
+    long long       context_switch = 0;         //!< kernel entries, IRETs and migrations
+    long long       load = 0;
+    size_t          allocation_failures = 0;    //!< FORKs and EXECs that found no memory
+};
+
+class time_profile_t {
+public:
+    static const size_t NO_FRAME = static_cast<size_t>(-1);
+
+    //returns the frame of process `pcb` forked by the process of frame `parent`
+    //(NO_FRAME for the first process)
+    size_t push(size_t parent, const PCB& pcb) {
+        frames.push_back({parent, pcb.program, pcb.PID});
+        pids[pcb.PID].program = pcb.program;
+        return frames.size() - 1;
+    }
+
+    //returns the frame of the process of `frame` once it EXEC'd the program of `pcb`
+    size_t replace(size_t frame, const PCB& pcb) {
+        return push(frames[frame].parent, pcb);
+    }
+
+    //Charges `ms` of `activity` (of device `device`, for the ISRs) to the process of `frame`
+    void charge(size_t frame, profile_activity_t activity, long long ms, int device = -1) {
+        if(ms <= 0) {
+            return;
+        }
+        folded[std::make_tuple(frame, activity, device)] += ms;
+        if(frame == NO_FRAME) {
+            return;
+        }
+
+        pid_times_t& times = pids[frames[frame].pid];
+        switch(activity) {
+        case profile_activity_t::CPU:
+            times.cpu += ms;
+            break;
+        case profile_activity_t::LOAD:
+            times.load += ms;
+            break;
+        case profile_activity_t::CONTEXT_SWITCH:
+        case profile_activity_t::MIGRATION:
+            times.context_switch += ms;
+            break;
+        default:
+            times.isr += ms;
+            break;
+        }
+    }
+
+    void allocation_failed(unsigned int pid) {
+        pids[pid].allocation_failures++;
+    }
+
+    //Writes one "<frame>;<frame>;...;<activity> <ms>" line per stack, the
+    //folded format flame graph tools read
+    //returns false if the file cannot be written
+    bool write_folded(const std::string& filename) const {
+        std::ofstream output_file(filename);
+        if(!output_file.is_open()) {
+            return false;
+        }
+        for(const auto& [key, ms] : folded) {
+            const auto& [frame, activity, device] = key;
+            output_file << stack(frame) << activity_name(activity);
+            if(device >= 0) {
+                output_file << " device " << device;
+            }
+            output_file << " " << ms << "\n";
+        }
+        output_file.close();
+        return !output_file.fail();
+    }
+
+    //Writes the totals of every process, by PID
+    //returns false if the file cannot be written
+    bool write_summary(const std::string& filename) const {
+        std::ofstream output_file(filename);
+        if(!output_file.is_open()) {
+            return false;
+        }
+        output_file << "PID, program, CPU, ISR, context switch, load, allocation failures\n";
+        for(const auto& [pid, times] : pids) {
+            output_file << pid << ", " << program_names().name(times.program) << ", " << times.cpu << ", "
+                        << times.isr << ", " << times.context_switch << ", " << times.load << ", "
+                        << times.allocation_failures << "\n";
+        }
+        output_file.close();
+        return !output_file.fail();
+    }
+
+private:
+    struct frame_t {
+        size_t          parent;
+        program_id_t    program;
+        unsigned int    pid;
+    };
+
+    static const char* activity_name(profile_activity_t activity) {
+        switch(activity) {
+        case profile_activity_t::CPU:               return "CPU";
+        case profile_activity_t::SYSCALL:           return "SYSCALL ISR";
+        case profile_activity_t::END_IO:            return "END_IO ISR";
+        case profile_activity_t::FORK:              return "FORK ISR";
+        case profile_activity_t::EXEC:              return "EXEC ISR";
+        case profile_activity_t::LOAD:              return "loading program";
+        case profile_activity_t::CONTEXT_SWITCH:    return "context switch";
+        case profile_activity_t::MIGRATION:         return "migration";
+        case profile_activity_t::IDLE:              return "CPU idle";
+        }
+        return "";
+    }
+
+    //returns "<frame>;...;" from the first process down to the one of `frame`
+    std::string stack(size_t frame) const {
+        std::vector<size_t> chain;
+        for(; frame != NO_FRAME; frame = frames[frame].parent) {
+            chain.push_back(frame);
+        }
+        std::string text;
+        for(auto f = chain.rbegin(); f != chain.rend(); ++f) {
+            text += program_names().name(frames[*f].program) + " (PID " + std::to_string(frames[*f].pid) + ");";
+        }
+        return text;
+    }
+
+    std::vector<frame_t>                                                    frames;
+    std::map<std::tuple<size_t, profile_activity_t, int>, long long>        folded;     //!< ms by frame, activity and device
+    std::map<unsigned int, pid_times_t>                                     pids;
+};
+
+//Writes the --time-profile and --pid-summary files of a run. A batch run gives
+//the directory of the trace's output, where the files go under their own name.
+void write_time_profile(const time_profile_t& profile, const sim_options_t& options, const std::filesystem::path& directory = {}) {
+    auto place = [&](const std::string& filename) {
+        return directory.empty() ? filename : (directory / std::filesystem::path(filename).filename()).string();
+    };
+    if(!options.time_profile_file.empty() && !profile.write_folded(place(options.time_profile_file))) {
+        std::cerr << "Error opening file " << place(options.time_profile_file) << "!" << std::endl;
+    }
+    if(!options.pid_summary_file.empty() && !profile.write_summary(place(options.pid_summary_file))) {
+        std::cerr << "Error opening file " << place(options.pid_summary_file) << "!" << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ *
+ * @file time_query.cpp
+ *
+ * Prints the process and partition state of a run at given times, from the
+ * --time-index file the run wrote, without reading its output files.
+ *
+ */
+
+#include "time_index.hpp"
+
+//returns the PCB a record of the index describes
+PCB record_pcb(const time_index_reader_t& index, const time_index_record_t& record) {
+    PCB pcb(record.pid, record.ppid, index.name(record.program), record.size, record.partition);
+    pcb.priority = record.priority;
+    return pcb;
+}
+
+//Appends the state at `time` the way system_status.txt shows a PCB table, then
+//the occupied partitions
+void format_state(std::string& out, time_index_reader_t& index, long long time, const time_index_state_t& state) {
+    out += "time: " + std::to_string(time) + " ms";
+    if(time < index.start_time()) {
+        out += "; the index starts at " + std::to_string(index.start_time()) + " ms\n\n";
+        return;
+    }
+    out += "; last change at " + std::to_string(state.last.time) + " ms, execution.txt byte "
+         + std::to_string(state.last.execution_offset) + ", system_status.txt byte " + std::to_string(state.last.status_offset) + "\n";
+
+    out += PCB_TABLE_HEADER;
+    auto running = state.processes.find(state.running);
+    if(running != state.processes.end()) {
+        format_PCB_row(out, record_pcb(index, running->second), "running");
+    }
+    for(const auto& [pid, record] : state.processes) {
+        if(pid != state.running) {
+            format_PCB_row(out, record_pcb(index, record), "waiting");
+        }
+    }
+    out += PCB_TABLE_FOOTER;
+
+    out += "occupied partitions: " + std::to_string(state.partitions.size()) + "\n";
+    for(const auto& [partition, record] : state.partitions) {
+        out += "partition " + std::to_string(partition) + ": ";
+        if(record.pid != time_index_state_t::NO_PID) {
+            out += "PID " + std::to_string(record.pid) + " ";
+        }
+        out += "(" + index.name(record.program) + "), " + std::to_string(record.size) + " Mb\n";
+    }
+    out += "\n";
+}
+
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        std::cout << "To query a time index, do: ./time_query <your_index_file> <time_in_ms> [<time_in_ms>...]" << std::endl;
+        return 1;
+    }
+
+    time_index_reader_t index;
+    if(!index.open(argv[1])) {
+        std::cerr << "Error: Unable to read time index: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::string out;
+    time_index_state_t state;
+    for(int i = 2; i < argc; i++) {
+        long long time;
+        try {
+            time = std::stoll(argv[i]);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid time: " << argv[i] << std::endl;
+            return 1;
+        }
+        if(!index.state_at(time, state)) {
+            std::cerr << "Error: Unable to read time index: " << argv[1] << std::endl;
+            return 1;
+        }
+        format_state(out, index, time, state);
+    }
+    if(index.info().end_time >= 0) {
+        out += "(the run ended at " + std::to_string(index.info().end_time) + " ms)\n";
+    }
+    std::cout << out;
+    return 0;
+}
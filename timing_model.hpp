@@ -0,0 +1,129 @@
+#ifndef TIMING_MODEL_HPP_
+#define TIMING_MODEL_HPP_
+
+#include "checkpoint.hpp"
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// How long each fixed step of the simulated hardware takes, in ms. The CPU
+// bursts and device delays come from the trace and the device table; these are
+// the costs the interrupt and EXEC handling adds around them.
+struct timing_model_t {
+    int switch_mode;        //!< switch to kernel mode
+    int context_save;       //!< save the context of the interrupted process
+    int find_vector;        //!< find the vector in memory
+    int load_isr_address;   //!< load the ISR address into the PC
+    int iret;               //!< IRET back to the process
+    int load_per_mb;        //!< EXEC: load one Mb of the program into memory
+    int mark_partition;     //!< EXEC: mark the partition as occupied
+    int update_pcb;         //!< EXEC: update the PCB
+
+    //returns the time from an interrupt to its ISR: mode switch, context save, vector lookup
+    constexpr int kernel_entry() const {
+        return switch_mode + context_save + find_vector + load_isr_address;
+    }
+};
+
+void save_timing_model(checkpoint_writer_t& out, const timing_model_t& timing) {
+    out.put(timing.switch_mode);
+    out.put(timing.context_save);
+    out.put(timing.find_vector);
+    out.put(timing.load_isr_address);
+    out.put(timing.iret);
+    out.put(timing.load_per_mb);
+    out.put(timing.mark_partition);
+    out.put(timing.update_pcb);
+}
+
+timing_model_t load_timing_model(checkpoint_reader_t& in) {
+    timing_model_t timing;
+    timing.switch_mode = in.get<int>();
+    timing.context_save = in.get<int>();
+    timing.find_vector = in.get<int>();
+    timing.load_isr_address = in.get<int>();
+    timing.iret = in.get<int>();
+    timing.load_per_mb = in.get<int>();
+    timing.mark_partition = in.get<int>();
+    timing.update_pcb = in.get<int>();
+    return timing;
+}
+
+// The timings the simulator has always used (and the expected outputs assume)
+constexpr timing_model_t LEGACY_TIMING = {1, 10, 1, 1, 1, 15, 3, 6};
+
+// The model of a build. A build for one hardware profile names it here, e.g.
+// -DSIM_TIMING_PROFILE="timing_model_t{1, 20, 1, 2, 1, 10, 3, 6}", and adds
+// -DSIM_FIXED_TIMING to compile it into the simulator as constants: --timing
+// is then rejected.
+#ifndef SIM_TIMING_PROFILE
+#define SIM_TIMING_PROFILE LEGACY_TIMING
+#endif
+
+constexpr timing_model_t BUILT_IN_TIMING = SIM_TIMING_PROFILE;
+
+//Finds the field of the model a profile file line names
+//returns nullptr for an unknown step
+int* timing_field(timing_model_t& model, const std::string& name) {
+    if(name == "switch_mode") {
+        return &model.switch_mode;
+    } else if(name == "context_save") {
+        return &model.context_save;
+    } else if(name == "find_vector") {
+        return &model.find_vector;
+    } else if(name == "load_isr_address") {
+        return &model.load_isr_address;
+    } else if(name == "iret") {
+        return &model.iret;
+    } else if(name == "load_per_mb") {
+        return &model.load_per_mb;
+    } else if(name == "mark_partition") {
+        return &model.mark_partition;
+    } else if(name == "update_pcb") {
+        return &model.update_pcb;
+    }
+    return nullptr;
+}
+
+//Reads a timing profile (--timing): "step, ms" per line, for any of the fields
+//of timing_model_t. The steps it does not name keep the built-in timing.
+timing_model_t load_timing_model(const std::string& filename) {
+    std::ifstream input_file(filename);
+    if (!input_file.is_open()) {
+        std::cerr << "Error: Unable to open file: " << filename << std::endl;
+        exit(1);
+    }
+
+    timing_model_t model = BUILT_IN_TIMING;
+    std::string line;
+    while(std::getline(input_file, line)) {
+        auto comma = line.find(',');
+        if(comma == std::string::npos) {
+            continue;
+        }
+        std::string name = line.substr(0, comma);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t\r") + 1);
+        int* field = timing_field(model, name);
+        if(field == nullptr) {
+            std::cerr << "Error: Unknown timing step: " << name << std::endl;
+            exit(1);
+        }
+        try {
+            size_t parsed = 0;
+            *field = std::stoi(line.substr(comma + 1), &parsed);
+            if(*field < 0 || line.find_first_not_of(" \t\r", comma + 1 + parsed) != std::string::npos) {
+                throw std::invalid_argument(line);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid timing: " << line << std::endl;
+            exit(1);
+        }
+    }
+    input_file.close();
+
+    return model;
+}
+
+#endif
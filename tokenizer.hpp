@@ -0,0 +1,140 @@
+#ifndef TOKENIZER_HPP_
+#define TOKENIZER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define TOKENIZER_SIMD 1
+#endif
+
+// Block tokenizer for the text inputs (traces, programs, device and external
+// file tables). Every input line is "<field>, <field>...": the loaders only
+// need where each line ends and where its first comma is. Those are found 64
+// bytes at a time as bit masks (with AVX2 if the CPU has it, SSE2 otherwise,
+// plain byte compares on other targets), then walked bit by bit, so a line
+// costs no search call and no copy. Integers are read in place.
+
+//Sets bit k of `newlines` and `commas` for each '\n' and ',' among the 64 bytes at `block`
+typedef void (*block_scanner_t)(const char* block, uint64_t& newlines, uint64_t& commas);
+
+void scan_block_scalar(const char* block, uint64_t& newlines, uint64_t& commas) {
+    newlines = 0;
+    commas = 0;
+    for(int k = 0; k < 64; k++) {
+        newlines |= static_cast<uint64_t>(block[k] == '\n') << k;
+        commas |= static_cast<uint64_t>(block[k] == ',') << k;
+    }
+}
+
+#ifdef TOKENIZER_SIMD
+__attribute__((target("sse2")))
+void scan_block_sse2(const char* block, uint64_t& newlines, uint64_t& commas) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i comma = _mm_set1_epi8(',');
+    newlines = 0;
+    commas = 0;
+    for(int k = 0; k < 64; k += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + k));
+        newlines |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)))) << k;
+        commas |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, comma)))) << k;
+    }
+}
+
+__attribute__((target("avx2")))
+void scan_block_avx2(const char* block, uint64_t& newlines, uint64_t& commas) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i comma = _mm256_set1_epi8(',');
+    __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    newlines = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newline)))
+             | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newline)))) << 32;
+    commas = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, comma)))
+           | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, comma)))) << 32;
+}
+#endif
+
+//returns the widest block scanner this CPU runs, picked once
+block_scanner_t block_scanner() {
+#ifdef TOKENIZER_SIMD
+    static const block_scanner_t scanner = __builtin_cpu_supports("avx2") ? scan_block_avx2
+                                         : __builtin_cpu_supports("sse2") ? scan_block_sse2
+                                         : scan_block_scalar;
+    return scanner;
+#else
+    return scan_block_scalar;
+#endif
+}
+
+//Calls on_line(line, comma, end) for each line of data, split the way
+//std::getline splits them: `comma` is the first ',' of the line (nullptr if it
+//has none) and `end` is where its '\n' (or the data) ends.
+template<typename on_line_t>
+void for_each_line(const char* data, size_t size, on_line_t on_line) {
+    block_scanner_t scan = block_scanner();
+    const char* line = data;
+    const char* comma = nullptr;
+    for(size_t block = 0; block < size; block += 64) {
+        uint64_t newlines;
+        uint64_t commas;
+        if(size - block >= 64) {
+            scan(data + block, newlines, commas);
+        } else {
+            //The last partial block is scanned from a zero-padded copy
+            char tail[64] = {};
+            memcpy(tail, data + block, size - block);
+            scan(tail, newlines, commas);
+        }
+
+        uint64_t marks = newlines | commas;
+        while(marks) {
+            int bit = __builtin_ctzll(marks);
+            const char* mark = data + block + bit;
+            if(newlines & (uint64_t(1) << bit)) {
+                on_line(line, comma, mark);
+                line = mark + 1;
+                comma = nullptr;
+            } else if(!comma) {
+                comma = mark;
+            }
+            marks &= marks - 1;
+        }
+    }
+    if(line < data + size) {
+        on_line(line, comma, data + size);
+    }
+}
+
+//Reads an int in place, exactly like std::stoi of [text, end) would in the
+//plain cases: leading whitespace, an optional sign, then up to 9 digits (so it
+//cannot overflow), anything after them ignored
+//returns false for anything else (no digits, too many digits), which the
+//caller hands to std::stoi to get the same result or error as before
+bool parse_int(const char* text, const char* end, int& value) {
+    while(text < end && (*text == ' ' || (*text >= '\t' && *text <= '\r'))) {
+        text++;
+    }
+    bool negative = false;
+    if(text < end && (*text == '-' || *text == '+')) {
+        negative = *text == '-';
+        text++;
+    }
+    int digits = 0;
+    int parsed = 0;
+    while(text < end && *text >= '0' && *text <= '9') {
+        if(++digits > 9) {
+            return false;
+        }
+        parsed = parsed * 10 + (*text - '0');
+        text++;
+    }
+    if(digits == 0) {
+        return false;
+    }
+    value = negative ? -parsed : parsed;
+    return true;
+}
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef TRACE_BINARY_HPP_
+#define TRACE_BINARY_HPP_
+
+#include "trace_ir.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TRACE_MMAP 1
+#endif
+
+// Binary trace format, version 1 (all fields in the writer's byte order, which
+// must match the reader's):
+//
+//   offset 0                 binary_trace_header_t (64 bytes)
+//   offset 64                record_count records of 16 bytes, laid out exactly
+//                            like instruction_t: activity (1 byte), 3 zero
+//                            bytes, operand, program_id and line_id (int32)
+//   offset strings_offset    string_count strings: uint32 length, then the bytes
+//
+// Because a record is an instruction_t, a mapped binary trace is simulated in
+// place without copying or parsing its instructions; only the (small) string
+// table is read into memory.
+
+const char      BINARY_TRACE_MAGIC[8] = {'S', 'I', 'M', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t  BINARY_TRACE_VERSION = 1;
+const uint32_t  BINARY_TRACE_BYTE_ORDER = 0x01020304;
+
+struct binary_trace_header_t {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    byte_order;     //!< BINARY_TRACE_BYTE_ORDER as written by the converter
+    uint32_t    record_size;    //!< sizeof(instruction_t)
+    uint32_t    string_count;
+    uint64_t    record_count;
+    uint64_t    strings_offset;
+    uint8_t     reserved[24];
+};
+
+static_assert(sizeof(binary_trace_header_t) == 64, "binary trace header must be 64 bytes");
+static_assert(sizeof(instruction_t) == 16
+              && offsetof(instruction_t, operand) == 4
+              && offsetof(instruction_t, program_id) == 8
+              && offsetof(instruction_t, line_id) == 12,
+              "binary trace records are read in place as instruction_t");
+
+//returns true if the data starts like a binary trace (as opposed to a text trace)
+bool is_binary_trace(const char* data, size_t size) {
+    return size >= sizeof(binary_trace_header_t) && std::memcmp(data, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) == 0;
+}
+
+//Checks a binary trace and points the compiled trace at its records. The
+//records are used in place, so `data` must outlive the compiled trace.
+//returns false if the data is not a valid version 1 binary trace
+bool read_binary_trace(const char* data, size_t size, compiled_trace_t& trace) {
+    if(!is_binary_trace(data, size)) {
+        return false;
+    }
+    binary_trace_header_t header;
+    std::memcpy(&header, data, sizeof(header));
+
+    if(header.version != BINARY_TRACE_VERSION || header.byte_order != BINARY_TRACE_BYTE_ORDER
+       || header.record_size != sizeof(instruction_t)) {
+        return false;
+    }
+    if(header.record_count > (size - sizeof(header)) / sizeof(instruction_t)
+       || header.strings_offset < sizeof(header) + header.record_count * sizeof(instruction_t)
+       || header.strings_offset > size
+       || header.string_count > (size - header.strings_offset) / sizeof(uint32_t)) {
+        return false;
+    }
+
+    std::vector<std::string> strings;
+    strings.reserve(header.string_count);
+    size_t offset = header.strings_offset;
+    for(uint32_t i = 0; i < header.string_count; i++) {
+        uint32_t length;
+        if(size - offset < sizeof(length)) {
+            return false;
+        }
+        std::memcpy(&length, data + offset, sizeof(length));
+        offset += sizeof(length);
+        if(size - offset < length) {
+            return false;
+        }
+        strings.emplace_back(data + offset, length);
+        offset += length;
+    }
+
+    //Every string id must be valid, the simulator indexes the table without
+    //checking: the ids an activity uses must name a string, the others may be -1
+    const instruction_t* records = reinterpret_cast<const instruction_t*>(data + sizeof(header));
+    const int string_count = static_cast<int>(header.string_count);
+    for(uint64_t i = 0; i < header.record_count; i++) {
+        const instruction_t& record = records[i];
+        if(static_cast<uint8_t>(record.activity) > static_cast<uint8_t>(activity_t::UNKNOWN)
+           || record.program_id < -1 || record.program_id >= string_count
+           || record.line_id < -1 || record.line_id >= string_count) {
+            return false;
+        }
+        bool needs_program = record.activity == activity_t::EXEC || record.activity == activity_t::UNKNOWN;
+        bool needs_line = record.activity == activity_t::EXEC || record.activity == activity_t::FORK;
+        if((needs_program && record.program_id < 0) || (needs_line && record.line_id < 0)) {
+            return false;
+        }
+    }
+
+    trace.code.clear();
+    trace.strings = std::move(strings);
+    trace.mapped = records;
+    trace.mapped_size = header.record_count;
+    return true;
+}
+
+//Writes a compiled trace in the binary trace format
+//returns false if the file cannot be written
+bool write_binary_trace(const compiled_trace_t& trace, const std::string& filename) {
+    std::ofstream output_file(filename, std::ios::binary);
+    if(!output_file.is_open()) {
+        return false;
+    }
+
+    binary_trace_header_t header{};
+    std::memcpy(header.magic, BINARY_TRACE_MAGIC, sizeof(header.magic));
+    header.version          = BINARY_TRACE_VERSION;
+    header.byte_order       = BINARY_TRACE_BYTE_ORDER;
+    header.record_size      = sizeof(instruction_t);
+    header.string_count     = trace.strings.size();
+    header.record_count     = trace.size();
+    header.strings_offset   = sizeof(header) + trace.size() * sizeof(instruction_t);
+    output_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    //Records are copied field by field so the padding bytes are always zero
+    std::vector<char> records;
+    const size_t chunk = 4096;
+    for(size_t first = 0; first < trace.size(); first += chunk) {
+        size_t count = std::min(chunk, trace.size() - first);
+        records.assign(count * sizeof(instruction_t), 0);
+        for(size_t i = 0; i < count; i++) {
+            const instruction_t& instruction = trace.instruction(first + i);
+            char* record = records.data() + i * sizeof(instruction_t);
+            std::memcpy(record + offsetof(instruction_t, activity),   &instruction.activity,   sizeof(instruction.activity));
+            std::memcpy(record + offsetof(instruction_t, operand),    &instruction.operand,    sizeof(instruction.operand));
+            std::memcpy(record + offsetof(instruction_t, program_id), &instruction.program_id, sizeof(instruction.program_id));
+            std::memcpy(record + offsetof(instruction_t, line_id),    &instruction.line_id,    sizeof(instruction.line_id));
+        }
+        output_file.write(records.data(), records.size());
+    }
+
+    for(const auto& s : trace.strings) {
+        uint32_t length = s.size();
+        output_file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        output_file.write(s.data(), s.size());
+    }
+
+    output_file.close();
+    return !output_file.fail();
+}
+
+//Loads a trace (or program) file, in either format: binary traces are mapped
+//and run in place, text traces are compiled.
+//returns false if the file cannot be opened or is not a valid binary trace
+bool load_trace_file(const std::string& filename, compiled_trace_t& trace) {
+#ifdef TRACE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) == 0 && info.st_size > 0) {
+        size_t size = info.st_size;
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(data == MAP_FAILED) {
+            return false;
+        }
+
+        const char* bytes = static_cast<const char*>(data);
+        if(!is_binary_trace(bytes, size)) {
+            trace = compile_trace(bytes, size);
+            munmap(data, size);
+            return true;
+        }
+
+        //The mapping stays alive as long as the trace (or a copy of it) does
+        std::shared_ptr<const void> mapping(data, [size](const void* mapped) {
+            munmap(const_cast<void*>(mapped), size);
+        });
+        if(!read_binary_trace(bytes, size, trace)) {
+            std::cerr << "Error: Invalid binary trace: " << filename << std::endl;
+            return false;
+        }
+        trace.mapping = std::move(mapping);
+        return true;
+    }
+    close(fd);
+#endif
+
+    std::ifstream input_file(filename, std::ios::binary);
+    if(!input_file.is_open()) {
+        return false;
+    }
+    auto contents = std::make_shared<std::string>((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
+    if(!is_binary_trace(contents->data(), contents->size())) {
+        trace = compile_trace(contents->data(), contents->size());
+        return true;
+    }
+
+    //Without mmap the whole file is read; it is kept alive as the mapping.
+    //std::string storage is suitably aligned for the records.
+    if(!read_binary_trace(contents->data(), contents->size(), trace)) {
+        std::cerr << "Error: Invalid binary trace: " << filename << std::endl;
+        return false;
+    }
+    trace.mapping = std::move(contents);
+    return true;
+}
+
+#endif
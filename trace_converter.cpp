@@ -0,0 +1,32 @@
+/**
+ *
+ * @file trace_converter.cpp
+ *
+ * Converts a text trace ("ACTIVITY, N" per line) or program into the binary
+ * trace format of trace_binary.hpp, which the simulator maps and runs in place.
+ *
+ */
+
+#include "trace_binary.hpp"
+
+int main(int argc, char** argv) {
+    if(argc != 3) {
+        std::cout << "To convert a trace, do: ./trace_converter <your_trace_file.txt> <your_trace_file.bin>" << std::endl;
+        return 1;
+    }
+
+    compiled_trace_t trace;
+    if(!load_trace_file(argv[1], trace)) {
+        std::cerr << "Error: Unable to open file: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    if(!write_binary_trace(trace, argv[2])) {
+        std::cerr << "Error opening file " << argv[2] << "!" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Converted " << trace.size() << " line(s) and " << trace.strings.size()
+              << " string(s) into " << argv[2] << std::endl;
+    return 0;
+}
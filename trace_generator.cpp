@@ -0,0 +1,256 @@
+/**
+ *
+ * @file trace_generator.cpp
+ *
+ * Generates large synthetic traces (and the programs they EXEC) for
+ * benchmarking the simulator. Everything generated is valid against the
+ * given vector table, device table and external files.
+ *
+ */
+
+#include "interrupts_101299776_101187793.hpp"
+#include <filesystem>
+#include <random>
+
+// What to generate, given as --name=value after the three tables
+struct generator_options_t {
+    size_t          lines = 100000;         //!< --lines=<n>: approximate length of the trace
+    std::string     output = "generated_trace.txt"; //!< --output=<file>
+    std::string     programs_dir = "generated_programs"; //!< --programs-dir=<dir>: where the programs are written
+    unsigned int    programs = 4;           //!< --programs=<n>: programs to generate (taken from external_files)
+    unsigned int    program_lines = 8;      //!< --program-lines=<n>: length of each program
+    unsigned int    fork_depth = 2;         //!< --fork-depth=<n>: deepest FORK nesting
+    unsigned int    partitions = 0;         //!< --partitions=<n>: also write <output>.partitions with n partitions
+    unsigned int    seed = 4001;            //!< --seed=<n>
+    // --mix=cpu:50,syscall:20,end_io:20,fork:5,exec:5 (relative weights)
+    std::vector<std::pair<std::string, unsigned int>> mix = {
+        {"CPU", 50}, {"SYSCALL", 20}, {"END_IO", 20}, {"FORK", 5}, {"EXEC", 5}
+    };
+};
+
+class trace_generator_t {
+public:
+    trace_generator_t(const generator_options_t& _options, unsigned int _devices, std::vector<external_file> _programs):
+        options(_options), devices(_devices), programs(std::move(_programs)), random(_options.seed) {
+        std::vector<unsigned int> weights;
+        for(const auto& [activity, weight] : options.mix) {
+            weights.push_back(weight);
+        }
+        pick_activity = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+    }
+
+    //Writes the whole top level trace
+    void write_trace(std::ostream& output) {
+        size_t written = 0;
+        while(written < options.lines) {
+            written += write_activity(output, 0);
+        }
+    }
+
+    //Writes a program: CPU bursts and I/O only, so every program ends
+    void write_program(std::ostream& output) {
+        for(unsigned int i = 0; i < options.program_lines; i++) {
+            write_simple(output, pick_simple());
+        }
+    }
+
+private:
+    //A bare EXEC would replace the process and cut the rest of the trace short,
+    //so an EXEC is generated as a spawn: a FORK whose child only EXECs
+    size_t write_activity(std::ostream& output, unsigned int depth) {
+        const std::string& activity = options.mix[pick_activity(random)].first;
+
+        if(activity == "FORK" && depth < options.fork_depth && !programs.empty()) {
+            return write_fork(output, depth, true);
+        }
+        if(activity == "EXEC" && !programs.empty()) {
+            return write_fork(output, depth, false);
+        }
+        if(activity == "FORK" || activity == "EXEC") {
+            return write_simple(output, pick_simple());
+        }
+        return write_simple(output, activity);
+    }
+
+    //FORK / IF_CHILD / child body / EXEC / IF_PARENT / parent body / ENDIF
+    //
+    //The child ends with an EXEC (so at least one program is needed) and its
+    //block stops at the IF_PARENT that follows. Nested FORKs go in the parent
+    //body: a child block is cut at its first EXEC, so a FORK inside it would
+    //have no parent branch.
+    size_t write_fork(std::ostream& output, unsigned int depth, bool with_bodies) {
+        size_t written = 0;
+        output << "FORK, " << duration(random) << "\n";
+        output << "IF_CHILD, 0\n";
+        written += 2;
+
+        int child_lines = with_bodies ? body_length(random) : 0;
+        for(int i = 0; i < child_lines; i++) {
+            written += write_simple(output, pick_simple());
+        }
+        written += write_exec(output);
+
+        output << "IF_PARENT, 0\n";
+        written++;
+        int parent_lines = with_bodies ? body_length(random) : 0;
+        for(int i = 0; i < parent_lines; i++) {
+            written += write_activity(output, depth + 1);
+        }
+        output << "ENDIF, 0\n";
+        return written + 1;
+    }
+
+    size_t write_exec(std::ostream& output) {
+        std::uniform_int_distribution<size_t> pick_program(0, programs.size() - 1);
+        output << "EXEC " << programs[pick_program(random)].program_name << ", " << duration(random) << "\n";
+        return 1;
+    }
+
+    size_t write_simple(std::ostream& output, const std::string& activity) {
+        if(activity == "SYSCALL" || activity == "END_IO") {
+            std::uniform_int_distribution<unsigned int> device(0, devices - 1);
+            output << activity << ", " << device(random) << "\n";
+        } else {
+            output << "CPU, " << duration(random) << "\n";
+        }
+        return 1;
+    }
+
+    std::string pick_simple() {
+        std::string activity;
+        do {
+            activity = options.mix[pick_activity(random)].first;
+        } while(activity == "FORK" || activity == "EXEC");
+        return activity;
+    }
+
+    const generator_options_t&              options;
+    unsigned int                            devices;
+    std::vector<external_file>              programs;
+    std::mt19937                            random;
+    std::discrete_distribution<size_t>      pick_activity;
+    std::uniform_int_distribution<int>      duration{1, 100};
+    std::uniform_int_distribution<int>      body_length{1, 4};
+};
+
+//Reads the --mix weights, e.g. cpu:50,syscall:20,end_io:20,fork:5,exec:5
+std::vector<std::pair<std::string, unsigned int>> parse_mix(const std::string& value) {
+    std::vector<std::pair<std::string, unsigned int>> mix;
+    for(const auto& entry : split_delim(value, ",")) {
+        auto parts = split_delim(entry, ":");
+        std::string activity = parts[0];
+        std::transform(activity.begin(), activity.end(), activity.begin(), ::toupper);
+        if(parts.size() != 2 || (activity != "CPU" && activity != "SYSCALL" && activity != "END_IO"
+                                 && activity != "FORK" && activity != "EXEC")) {
+            throw std::invalid_argument(entry);
+        }
+        mix.push_back({activity, static_cast<unsigned int>(std::stoul(parts[1]))});
+    }
+    bool has_simple = false;
+    for(const auto& [activity, weight] : mix) {
+        has_simple |= weight > 0 && activity != "FORK" && activity != "EXEC";
+    }
+    if(!has_simple) {
+        throw std::invalid_argument(value);
+    }
+    return mix;
+}
+
+generator_options_t parse_generator_options(int argc, char** argv) {
+    generator_options_t options;
+
+    for(int i = 4; i < argc; i++) {
+        std::string option(argv[i]);
+        std::string value;
+        auto equals = option.find('=');
+        if(equals != std::string::npos) {
+            value = option.substr(equals + 1);
+            option = option.substr(0, equals);
+        }
+
+        try {
+            if(option == "--lines") {
+                options.lines = std::stoul(value);
+            } else if(option == "--output") {
+                options.output = value;
+            } else if(option == "--programs-dir") {
+                options.programs_dir = value;
+            } else if(option == "--programs") {
+                options.programs = std::stoul(value);
+            } else if(option == "--program-lines") {
+                options.program_lines = std::stoul(value);
+            } else if(option == "--fork-depth") {
+                options.fork_depth = std::stoul(value);
+            } else if(option == "--partitions") {
+                options.partitions = std::stoul(value);
+            } else if(option == "--seed") {
+                options.seed = std::stoul(value);
+            } else if(option == "--mix") {
+                options.mix = parse_mix(value);
+            } else {
+                std::cerr << "Error: Unknown option: " << argv[i] << std::endl;
+                exit(1);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid value for option: " << argv[i] << std::endl;
+            exit(1);
+        }
+    }
+
+    return options;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 4) {
+        std::cout << "To run the generator, do: ./trace_generator <your_vector_table.txt> <your_device_table.txt> <your_external_files.txt> "
+                  << "[--lines=<n>] [--output=<file>] [--programs-dir=<dir>] [--programs=<n>] [--program-lines=<n>] "
+                  << "[--fork-depth=<n>] [--partitions=<n>] [--mix=cpu:50,syscall:20,end_io:20,fork:5,exec:5] [--seed=<n>]" << std::endl;
+        return 1;
+    }
+
+    //parse_args wants the trace first, the generator does not have one yet
+    std::vector<char*> args = {argv[0], argv[1], argv[1], argv[2], argv[3]};
+    auto [vectors, delays, external_files] = parse_args(args.size(), args.data());
+    generator_options_t options = parse_generator_options(argc, argv);
+
+    //A device is only usable if it has both an ISR address and a delay
+    unsigned int devices = std::min(vectors.size(), delays.size());
+    if(devices == 0) {
+        std::cerr << "Error: the vector and device tables are empty" << std::endl;
+        return 1;
+    }
+
+    //EXEC targets: the first --programs entries of external_files
+    std::vector<external_file> programs(external_files.begin(),
+                                        external_files.begin() + std::min<size_t>(options.programs, external_files.size()));
+
+    trace_generator_t generator(options, devices, programs);
+
+    std::filesystem::create_directories(options.programs_dir);
+    unsigned int largest = 1;
+    for(const auto& program : programs) {
+        std::ofstream program_file(std::filesystem::path(options.programs_dir) / (program.program_name + ".txt"));
+        generator.write_program(program_file);
+        largest = std::max(largest, program.size);
+    }
+
+    std::ofstream trace_file(options.output);
+    if(!trace_file.is_open()) {
+        std::cerr << "Error: Unable to open file: " << options.output << std::endl;
+        return 1;
+    }
+    generator.write_trace(trace_file);
+    trace_file.close();
+
+    //Every forked child keeps its partition, so big traces need a big partition table
+    if(options.partitions > 0) {
+        std::ofstream partitions_file(options.output + ".partitions");
+        for(unsigned int i = 0; i < options.partitions; i++) {
+            partitions_file << largest << "\n";
+        }
+    }
+
+    std::cout << "Trace written to " << options.output << ", " << programs.size() << " program(s) in "
+              << options.programs_dir << std::endl;
+    return 0;
+}
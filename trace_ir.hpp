@@ -0,0 +1,456 @@
+#ifndef TRACE_IR_HPP_
+#define TRACE_IR_HPP_
+
+#include "interrupts_101299776_101187793.hpp"
+#include "tokenizer.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <memory>
+#include <cstring>
+#include <mutex>
+
+// Trace activities, resolved once when a trace is compiled so the simulator
+// never compares activity strings in its main loop
+enum class activity_t : uint8_t {
+    CPU,
+    SYSCALL,
+    END_IO,
+    FORK,
+    EXEC,
+    IF_CHILD,
+    IF_PARENT,
+    ENDIF,
+    UNKNOWN
+};
+
+// One compiled trace line
+struct instruction_t {
+    activity_t  activity;
+    int         operand;     //!< duration or interrupt number (-1 if not applicable)
+    int         program_id;  //!< EXEC: program name, UNKNOWN: activity name (-1 otherwise)
+    int         line_id;     //!< FORK/EXEC: original trace line, used by the system status (-1 otherwise)
+};
+
+// A trace compiled into instructions. Every string the simulator may need to
+// print (program names, unknown activities, FORK/EXEC lines) is interned once
+// in `strings` and referenced by index from the instructions.
+//
+// A trace loaded from a binary trace file (trace_binary.hpp) does not copy its
+// instructions: they are read straight from the mapped file through `mapped`.
+// A streamed trace (trace_stream_t) only holds the lines from `first` on.
+class trace_stream_t;
+
+struct compiled_trace_t {
+    std::vector<instruction_t>              code;
+    std::vector<std::string>                strings;
+    std::unordered_map<std::string, int>    string_ids;
+    const instruction_t*                    mapped = nullptr;   //!< instructions of a mapped binary trace (code is empty then)
+    size_t                                  mapped_size = 0;
+    std::shared_ptr<const void>             mapping;            //!< keeps the mapped file alive
+    size_t                                  first = 0;          //!< streamed: index of the line at code[0], earlier lines are dropped
+    trace_stream_t*                         stream = nullptr;   //!< streamed: reads and drops lines as the simulation goes
+
+    //Lines so far (a streamed trace may have more to come)
+    size_t size() const {
+        return mapped ? mapped_size : first + code.size();
+    }
+
+    const instruction_t& instruction(size_t i) const {
+        return mapped ? mapped[i] : code[i - first];
+    }
+
+    int intern(const std::string& s) {
+        auto found = string_ids.find(s);
+        if(found != string_ids.end()) {
+            return found->second;
+        }
+        int id = strings.size();
+        strings.push_back(s);
+        string_ids.emplace(s, id);
+        return id;
+    }
+
+    const std::string& str(int id) const {
+        return strings[id];
+    }
+
+    //returns a hash (FNV-1a) of every instruction and the strings it names,
+    //the same for a text trace and its binary conversion
+    uint64_t hash() const {
+        uint64_t value = 14695981039346656037ULL;
+        auto mix = [&value](const void* data, size_t size) {
+            for(size_t i = 0; i < size; i++) {
+                value = (value ^ static_cast<const unsigned char*>(data)[i]) * 1099511628211ULL;
+            }
+        };
+        for(size_t i = 0; i < size(); i++) {
+            const instruction_t& line = instruction(i);
+            mix(&line.activity, sizeof(line.activity));
+            mix(&line.operand, sizeof(line.operand));
+            for(int id : {line.program_id, line.line_id}) {
+                const std::string& text = id < 0 ? std::string() : str(id);
+                uint32_t length = text.size();
+                mix(&length, sizeof(length));
+                mix(text.data(), text.size());
+            }
+        }
+        return value;
+    }
+};
+
+//Maps the activity string returned by parse_trace to its opcode
+activity_t activity_from_string(const std::string& activity) {
+    static const std::unordered_map<std::string, activity_t> activities = {
+        {"CPU",       activity_t::CPU},
+        {"SYSCALL",   activity_t::SYSCALL},
+        {"END_IO",    activity_t::END_IO},
+        {"FORK",      activity_t::FORK},
+        {"EXEC",      activity_t::EXEC},
+        {"IF_CHILD",  activity_t::IF_CHILD},
+        {"IF_PARENT", activity_t::IF_PARENT},
+        {"ENDIF",     activity_t::ENDIF}
+    };
+
+    auto found = activities.find(activity);
+    return found == activities.end() ? activity_t::UNKNOWN : found->second;
+}
+
+//Compiles a single trace line and appends it to the compiled trace
+void compile_line(const std::string& trace, compiled_trace_t& compiled) {
+    auto [activity, duration_intr, program_name] = parse_trace(trace);
+
+    instruction_t instruction;
+    instruction.activity    = activity_from_string(activity);
+    instruction.operand     = duration_intr;
+    instruction.program_id  = -1;
+    instruction.line_id     = -1;
+
+    switch(instruction.activity) {
+        case activity_t::EXEC:
+            instruction.program_id = compiled.intern(program_name);
+            instruction.line_id    = compiled.intern(trace);
+            break;
+        case activity_t::FORK:
+            instruction.line_id    = compiled.intern(trace);
+            break;
+        case activity_t::UNKNOWN:
+            instruction.program_id = compiled.intern(activity);
+            break;
+        default:
+            break;
+    }
+
+    compiled.code.push_back(instruction);
+}
+
+//Compiles the line [line, end) whose first comma the tokenizer found. The
+//usual lines ("CPU, 50", "EXEC program1, 50", "IF_CHILD, 0") are compiled in
+//place; anything else goes through compile_line, so odd or malformed lines
+//give the same instructions and errors as ever.
+void compile_fields(const char* line, const char* comma, const char* end, compiled_trace_t& compiled) {
+    if(comma) {
+        std::string_view activity(line, comma - line);
+        instruction_t instruction;
+        instruction.activity    = activity_t::UNKNOWN;
+        instruction.operand     = -1;
+        instruction.program_id  = -1;
+        instruction.line_id     = -1;
+        bool has_operand = true;
+        if(activity == "CPU") {
+            instruction.activity = activity_t::CPU;
+        } else if(activity == "SYSCALL") {
+            instruction.activity = activity_t::SYSCALL;
+        } else if(activity == "END_IO") {
+            instruction.activity = activity_t::END_IO;
+        } else if(activity == "FORK") {
+            instruction.activity = activity_t::FORK;
+        } else if(activity.size() > 5 && activity.compare(0, 5, "EXEC ") == 0) {
+            instruction.activity = activity_t::EXEC;
+        } else if(activity == "IF_CHILD") {
+            instruction.activity = activity_t::IF_CHILD;
+            has_operand = false;
+        } else if(activity == "IF_PARENT") {
+            instruction.activity = activity_t::IF_PARENT;
+            has_operand = false;
+        } else if(activity == "ENDIF") {
+            instruction.activity = activity_t::ENDIF;
+            has_operand = false;
+        }
+
+        if(instruction.activity != activity_t::UNKNOWN && (!has_operand || parse_int(comma + 1, end, instruction.operand))) {
+            if(instruction.activity == activity_t::EXEC) {
+                //The program name is the second word, like parse_trace takes it
+                std::string_view program = activity.substr(5);
+                program = program.substr(0, program.find(' '));
+                instruction.program_id = compiled.intern(std::string(program));
+            }
+            if(instruction.activity == activity_t::EXEC || instruction.activity == activity_t::FORK) {
+                instruction.line_id = compiled.intern(std::string(line, end - line));
+            }
+            compiled.code.push_back(instruction);
+            return;
+        }
+    }
+    compile_line(std::string(line, end - line), compiled);
+}
+
+//Compiles a line read on its own (without its '\n')
+void compile_text_line(const std::string& line, compiled_trace_t& compiled) {
+    const char* comma = static_cast<const char*>(memchr(line.data(), ',', line.size()));
+    compile_fields(line.data(), comma, line.data() + line.size(), compiled);
+}
+
+//Reads a whole trace (or program) and compiles it line by line
+compiled_trace_t compile_trace(std::istream& input) {
+    SIM_STAT_TIMER(PARSE);
+    compiled_trace_t compiled;
+    std::string trace;
+    while(std::getline(input, trace)) {
+        compile_text_line(trace, compiled);
+    }
+    return compiled;
+}
+
+//Compiles a trace held in memory (e.g. a mapped file), splitting lines the
+//same way std::getline does
+compiled_trace_t compile_trace(const char* data, size_t size) {
+    SIM_STAT_TIMER(PARSE);
+    compiled_trace_t compiled;
+    for_each_line(data, size, [&](const char* line, const char* comma, const char* end) {
+        compile_fields(line, comma, end, compiled);
+    });
+    return compiled;
+}
+
+// Compiles a text trace from a stream (stdin, a FIFO) while it is simulated.
+// Lines are read as the simulation reaches them and dropped once the process
+// running the trace is past them, so memory does not grow with the length of
+// the trace. Only its distinct FORK/EXEC lines and program names are kept.
+//
+// `lookahead` bounds how many lines may be held past the running process: a
+// FORK has to see the end of its block before the child can run, and a block
+// longer than that is an error. The block ends at the first IF_PARENT after
+// the child's EXEC; without an EXEC it runs to the last IF_PARENT of the trace
+// (see resolve_fork), so only the end of the input settles it.
+class trace_stream_t {
+public:
+    trace_stream_t(std::istream& _input, compiled_trace_t& _trace, size_t _lookahead):
+        input(_input), trace(_trace), lookahead(_lookahead ? _lookahead : 1) {
+        trace.stream = this;
+    }
+
+    trace_stream_t(const trace_stream_t&) = delete;
+    trace_stream_t& operator=(const trace_stream_t&) = delete;
+
+    //Reads lines until line i is in memory or the input ends
+    //returns true if the trace has a line i
+    bool fill(size_t i) {
+        while(trace.size() <= i) {
+            if(ended) {
+                return false;
+            }
+            if(i - released >= lookahead) {
+                std::cerr << "Error: Streamed trace needs more than " << lookahead << " lines of lookahead at line "
+                          << released + 1 << " (a FORK block is too long, see --lookahead)" << std::endl;
+                exit(1);
+            }
+            if(!std::getline(input, line)) {
+                ended = true;
+                return false;
+            }
+            compile_text_line(line, trace);
+        }
+        return true;
+    }
+
+    //Drops the lines before i. Memory is given back once the dropped lines
+    //outnumber the ones still held, so dropping is amortised O(1) per line.
+    void release(size_t i) {
+        if(i <= released) {
+            return;
+        }
+        released = std::min(i, trace.size());
+        size_t dead = released - trace.first;
+        if(dead >= 4096 && dead >= trace.code.size() / 2) {
+            trace.code.erase(trace.code.begin(), trace.code.begin() + dead);
+            trace.first = released;
+        }
+    }
+
+private:
+    std::istream&       input;
+    compiled_trace_t&   trace;
+    size_t              lookahead;
+    size_t              released = 0;   //!< lines before this one are no longer needed
+    bool                ended = false;
+    std::string         line;
+};
+
+struct trace_view_t;
+
+// Where a FORK sends each process: the child runs `child`, the parent resumes
+// after `parent_index` (a position in the view that holds the FORK)
+struct fork_branch_t {
+    std::unique_ptr<trace_view_t>   child;
+    size_t                          parent_index;
+};
+
+// Consecutive source lines of a child view: the positions from `position` on
+// are the source lines from `line` on, up to the next run
+struct view_run_t {
+    uint32_t    position;
+    uint32_t    line;
+};
+
+// The instructions one process runs. The whole compiled trace is a view over
+// every line; a forked child is a view over the subset of its parent's lines
+// picked out by the IF_CHILD/IF_PARENT/ENDIF blocks, stored as runs of source
+// lines (its IF_CHILD block, then the tail after each ENDIF) so no instruction
+// is copied. The children of a streamed trace copy their instructions instead,
+// since the trace drops its lines once they are run.
+struct trace_view_t {
+    const compiled_trace_t*                             source;
+    std::vector<view_run_t>                             runs;       //!< source lines of a child view, unused when whole or owned
+    size_t                                              count = 0;  //!< positions covered by runs
+    std::vector<instruction_t>                          owned;      //!< the instructions themselves, for children of a streamed trace
+    bool                                                whole;
+    bool                                                owns = false;
+    const trace_view_t*                                 parent = nullptr;   //!< view holding the FORK that made this child view
+    size_t                                              fork = 0;           //!< position of that FORK in the parent view
+    mutable std::mutex                                  branches_lock;
+    mutable std::unordered_map<size_t, fork_branch_t>   branches;   //!< FORK position -> branch, filled by branch_at
+
+    explicit trace_view_t(const compiled_trace_t* _source):
+        source(_source), whole(true) {}
+
+    trace_view_t(const compiled_trace_t* _source, std::vector<view_run_t> _runs, size_t _count):
+        source(_source), runs(std::move(_runs)), count(_count), whole(false) {}
+
+    trace_view_t(const compiled_trace_t* _source, std::vector<instruction_t> _owned):
+        source(_source), owned(std::move(_owned)), whole(false), owns(true) {}
+
+    //The whole of a streamed trace: its size grows as it is read
+    bool streamed() const {
+        return whole && source->stream;
+    }
+
+    size_t size() const {
+        return whole ? source->size() : owns ? owned.size() : count;
+    }
+
+    //Index of position i in the source trace (or, in an owned view, in owned)
+    uint32_t line(size_t i) const {
+        if(whole || owns) {
+            return i;
+        }
+        auto run = std::upper_bound(runs.begin(), runs.end(), i,
+                                    [](size_t position, const view_run_t& run) { return position < run.position; }) - 1;
+        return run->line + (i - run->position);
+    }
+
+    const instruction_t& operator[](size_t i) const {
+        return whole ? source->instruction(i) : owns ? owned[i] : source->instruction(line(i));
+    }
+
+    //returns true if the view has an instruction at position i (reading a
+    //streamed trace up to it)
+    bool contains(size_t i) const {
+        return i < size() || (streamed() && source->stream->fill(i));
+    }
+
+    //The process running this view is at position i: a streamed trace drops
+    //the lines before it
+    //returns true if there is an instruction at position i
+    bool reached(size_t i) const {
+        if(!streamed()) {
+            return i < size();
+        }
+        source->stream->release(i);
+        return source->stream->fill(i);
+    }
+};
+
+//Collects the child's lines for the FORK at position `fork` of the view and
+//the position the parent is supposed to continue from.
+//The child skips everything outside IF_CHILD blocks and anything after an EXEC,
+//the parent resumes from the last IF_PARENT (or the first one after an EXEC).
+//The child of a streamed trace, or of a view that copied its instructions,
+//copies its own.
+fork_branch_t resolve_fork(const trace_view_t& view, size_t fork) {
+    bool copies = view.streamed() || view.owns;
+    std::vector<instruction_t> owned;
+    std::vector<view_run_t> runs;
+    size_t count = 0;
+    auto keep = [&](size_t j) {
+        if(copies) {
+            owned.push_back(view[j]);
+            return;
+        }
+        uint32_t line = view.line(j);
+        if(runs.empty() || runs.back().line + (count - runs.back().position) != line) {
+            runs.push_back({static_cast<uint32_t>(count), line});
+        }
+        count++;
+    };
+
+    bool skip = true;
+    bool exec_flag = false;
+    size_t parent_index = 0;
+
+    for(size_t j = fork; view.contains(j); j++) {
+        activity_t activity = view[j].activity;
+        if(skip && activity == activity_t::IF_CHILD) {
+            skip = false;
+            continue;
+        } else if(activity == activity_t::IF_PARENT){
+            skip = true;
+            parent_index = j;
+            if(exec_flag) {
+                break;
+            }
+        } else if(skip && activity == activity_t::ENDIF) {
+            skip = false;
+            continue;
+        } else if(!skip && activity == activity_t::EXEC) {
+            skip = true;
+            keep(j);
+            exec_flag = true;
+        }
+
+        if(!skip) {
+            keep(j);
+        }
+    }
+
+    //The parent of a streamed trace cannot go back to the lines after the FORK
+    if(view.streamed() && parent_index == 0) {
+        std::cerr << "Error: FORK at line " << fork + 1 << " of the streamed trace has no IF_PARENT" << std::endl;
+        exit(1);
+    }
+
+    std::unique_ptr<trace_view_t> child;
+    if(copies) {
+        child = std::make_unique<trace_view_t>(view.source, std::move(owned));
+    } else {
+        child = std::make_unique<trace_view_t>(view.source, std::move(runs), count);
+    }
+    child->parent = &view;
+    child->fork = fork;
+    return {std::move(child), parent_index};
+}
+
+//returns the branch of the FORK at position `fork` of the view, resolving it
+//the first time that FORK runs so a FORK that never gets a child costs nothing.
+//Safe to call from several threads. Not for a streamed trace: its FORKs are
+//resolved as they are run and not kept.
+const fork_branch_t& branch_at(const trace_view_t& view, size_t fork) {
+    std::lock_guard<std::mutex> lock(view.branches_lock);
+    auto branch = view.branches.find(fork);
+    if(branch == view.branches.end()) {
+        branch = view.branches.emplace(fork, resolve_fork(view, fork)).first;
+    }
+    return branch->second;
+}
+
+#endif